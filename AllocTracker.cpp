@@ -0,0 +1,95 @@
+/*
+ * Implementation of the opt-in per-query allocation tracker.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include "AllocTracker.h"
+
+#include <cstdlib>
+#include <new>
+
+/** The innermost scope active on the calling thread, if any. This is a
+ * plain pointer so that operator new can read it even while the thread's
+ * other thread-local objects are being destroyed.
+ */
+static thread_local AllocTracker::Scope* threadScope = nullptr;
+
+AllocTracker::Scope::Scope(ContextPtr context) :
+    context(std::move(context)), previous(threadScope) {
+    threadScope = this;
+}
+
+AllocTracker::Scope::~Scope() {
+    threadScope = previous;
+}
+
+bool AllocTracker::enabled() {
+#ifdef SQLAIR_TRACK_ALLOC
+    return true;
+#else
+    return false;
+#endif
+}
+
+AllocTracker::ContextPtr AllocTracker::newContext() {
+    return (enabled() ? std::make_shared<Context>() : nullptr);
+}
+
+AllocTracker::ContextPtr AllocTracker::context() {
+    return (threadScope != nullptr ? threadScope->context : nullptr);
+}
+
+AllocTracker::Stats AllocTracker::current() {
+    const Context* const context = (threadScope != nullptr ?
+                                    threadScope->context.get() : nullptr);
+    if (context == nullptr) {
+        return Stats{};
+    }
+    return Stats{context->count.load(std::memory_order_relaxed),
+                 context->bytes.load(std::memory_order_relaxed)};
+}
+
+void AllocTracker::record(size_t bytes) {
+    Context* const context = (threadScope != nullptr ?
+                              threadScope->context.get() : nullptr);
+    if (context != nullptr) {
+        context->count.fetch_add(1, std::memory_order_relaxed);
+        context->bytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+}
+
+#ifdef SQLAIR_TRACK_ALLOC
+// Replacements for the global allocation functions. The remaining forms
+// (nothrow, array, sized delete) are routed by the standard library to
+// these functions. The aligned forms are used by the default memory
+// resource, e.g., for the overflow memory of a query's arena.
+
+void* operator new(std::size_t size) {
+    AllocTracker::record(size);
+    if (void* ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void* operator new(std::size_t size, std::align_val_t align) {
+    AllocTracker::record(size);
+    const size_t alignment = static_cast<size_t>(align);
+    // aligned_alloc requires the size to be a multiple of the alignment
+    const size_t rounded = (size + alignment - 1) / alignment * alignment;
+    if (void* ptr = std::aligned_alloc(alignment, rounded ? rounded :
+                                       alignment)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+#endif
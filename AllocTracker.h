@@ -0,0 +1,163 @@
+#ifndef ALLOC_TRACKER_H
+#define ALLOC_TRACKER_H
+
+/*
+ * A lightweight, opt-in tracker that counts the heap allocations made for
+ * each query. Tracking is enabled by compiling with -DSQLAIR_TRACK_ALLOC,
+ * in which case the global operator new is hooked to bump the counters of
+ * the tracking context of the calling thread. A query may use several
+ * threads (e.g., to preload tables, download ranges, or scan shards). So
+ * the context is propagated to the tasks run on behalf of the query (see
+ * wrap()). Overflow memory obtained by a query's arena (see QueryArena)
+ * is allocated via operator new and is hence counted as well.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+/**
+ * This class has static helper methods to track allocations. Similar to
+ * the Helper class, this class is never instantiated.
+ */
+class AllocTracker {
+public:
+    /**
+     * A simple snapshot of allocation counters. The difference between two
+     * snapshots gives the allocations performed in between.
+     */
+    struct Stats {
+        /** The number of calls made to operator new */
+        size_t count = 0;
+        /** The total number of bytes requested from operator new */
+        size_t bytes = 0;
+
+        /**
+         * Convenience operator to compute the allocations performed between
+         * two snapshots.
+         *
+         * @param start The earlier snapshot to be subtracted.
+         *
+         * @return The allocations performed since the start snapshot.
+         */
+        Stats operator-(const Stats& start) const {
+            return Stats{count - start.count, bytes - start.bytes};
+        }
+    };
+
+    /**
+     * The counters shared by all the threads working on one query. They
+     * are updated with relaxed atomic operations.
+     */
+    struct Context {
+        /** The number of calls made to operator new */
+        std::atomic<size_t> count = {0};
+        /** The total number of bytes requested from operator new */
+        std::atomic<size_t> bytes = {0};
+    };
+
+    /** A shared pointer to a context, held by the threads using it */
+    using ContextPtr = std::shared_ptr<Context>;
+
+    /**
+     * An RAII class that makes a context the tracking context of the
+     * calling thread until this object goes out of scope. The previous
+     * context of the thread (if any) is then restored.
+     */
+    class Scope {
+    public:
+        /**
+         * Installs a context on the calling thread.
+         *
+         * @param context The context to be used. If it is nullptr, the
+         * allocations of the calling thread are not tracked.
+         */
+        explicit Scope(ContextPtr context);
+
+        /** Restores the previous context of the calling thread */
+        ~Scope();
+
+        /** The scope is tied to a thread and hence cannot be copied */
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        friend class AllocTracker;
+
+        /** The context installed by this scope */
+        const ContextPtr context;
+
+        /** The scope that was active on the thread before this one */
+        Scope* const previous;
+    };
+
+    /**
+     * Determine if allocation tracking was compiled into this program.
+     *
+     * @return This method returns true only if the program was compiled
+     * with SQLAIR_TRACK_ALLOC defined.
+     */
+    static bool enabled();
+
+    /**
+     * Create a context to track the allocations of a query.
+     *
+     * @return A new context, or nullptr if tracking is not enabled (so
+     * that untracked queries do not allocate a context).
+     */
+    static ContextPtr newContext();
+
+    /**
+     * Obtain the tracking context of the calling thread, e.g., to pass it
+     * on to another thread.
+     *
+     * @return The context or nullptr if the thread is not tracked.
+     */
+    static ContextPtr context();
+
+    /**
+     * Obtain the counters of the tracking context of the calling thread.
+     *
+     * @return The counters accumulated by all the threads using the
+     * context so far. If the thread is not tracked, the counters are zero.
+     */
+    static Stats current();
+
+    /**
+     * Wrap a task that is to be run on another thread so that it uses the
+     * tracking context of the calling thread.
+     *
+     * @param task The task (a callable object) to be wrapped.
+     *
+     * @return A callable object that runs the task in a Scope with the
+     * context of the calling thread.
+     */
+    template<typename Task>
+    static auto wrap(Task task) {
+        return [context = context(), task = std::move(task)]
+            (auto&&... args) mutable {
+            Scope scope(context);
+            return task(std::forward<decltype(args)>(args)...);
+        };
+    }
+
+    /**
+     * Record an allocation for the calling thread. This method is called
+     * from the hooked operator new and should not be called directly.
+     *
+     * @param bytes The number of bytes that were requested.
+     */
+    static void record(size_t bytes);
+
+private:
+    /**
+     * This class is never meant to be instantiated. Hence the constructor
+     * is intentionally private.
+     */
+    AllocTracker();
+};
+
+#endif /* ALLOC_TRACKER_H */
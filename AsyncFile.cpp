@@ -0,0 +1,581 @@
+/*
+ * Implementation of the streams that read and write files using several
+ * large asynchronous requests in flight.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include "AsyncFile.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include "Helper.h"
+
+#ifdef SQLAIR_USE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace {
+
+/**
+ * Synchronously read or write the remainder of a request that completed
+ * only partially (or run a whole request).
+ *
+ * @return The number of bytes transferred (which is short only at end of
+ * file) or -errno on errors.
+ */
+ssize_t transfer(const bool write, const int fd, char* buf, const size_t len,
+                 const off_t offset) {
+    size_t done = 0;
+    while (done < len) {
+        const ssize_t n = write ?
+            pwrite(fd, buf + done, len - done, offset + done) :
+            pread(fd, buf + done, len - done, offset + done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return -errno;
+        }
+        if (n == 0) {
+            break;  // End of file
+        }
+        done += n;
+    }
+    return done;
+}
+
+/**
+ * A small, fixed pool of threads that run the requests of all the IoQueues
+ * that do not use io_uring. Each request is a pread/pwrite that does not
+ * depend on other requests. So a few threads suffice to keep the disk busy.
+ */
+class IoThreads {
+public:
+    /** The number of threads in the pool */
+    static constexpr unsigned NumThreads = 4;
+
+    /**
+     * Obtain the pool, which is started on first use.
+     *
+     * @return The process-wide pool.
+     */
+    static IoThreads& get() {
+        static IoThreads pool;
+        return pool;
+    }
+
+    /**
+     * Queue a request to be run by one of the threads (see transfer()).
+     *
+     * @return A future that becomes ready with the result of the request.
+     */
+    std::future<ssize_t> run(const bool write, const int fd, char* buf,
+                             const size_t len, const off_t offset) {
+        std::packaged_task<ssize_t()> task([=] {
+            return transfer(write, fd, buf, len, offset); });
+        std::future<ssize_t> result = task.get_future();
+        {
+            std::scoped_lock<std::mutex> lock(mutex);
+            tasks.push_back(std::move(task));
+        }
+        changed.notify_one();
+        return result;
+    }
+
+    /** Finishes the queued requests and stops the threads. */
+    ~IoThreads() {
+        {
+            std::scoped_lock<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        for (auto& thr : threads) {
+            thr.join();
+        }
+    }
+
+private:
+    /** The constructor is private. The pool is obtained via get(). */
+    IoThreads() {
+        for (unsigned i = 0; (i < NumThreads); i++) {
+            threads.emplace_back(&IoThreads::work, this);
+        }
+    }
+
+    /** The method run by each thread of the pool */
+    void work() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            changed.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (tasks.empty()) {
+                return;  // Stopping and all requests are done
+            }
+            std::packaged_task<ssize_t()> task = std::move(tasks.front());
+            tasks.pop_front();
+            lock.unlock();
+            task();
+            lock.lock();
+        }
+    }
+
+    /** The requests that have not yet been run */
+    std::deque<std::packaged_task<ssize_t()>> tasks;
+
+    /** Flag set to stop the threads */
+    bool stopping = false;
+
+    /** The mutex to protect the requests and the flag */
+    std::mutex mutex;
+
+    /** Signaled when a request is queued or the pool is stopped */
+    std::condition_variable changed;
+
+    /** The threads of the pool */
+    std::vector<std::thread> threads;
+};
+
+}  // namespace
+
+// ----------------------------------------------------------------------
+//   IoQueue
+// ----------------------------------------------------------------------
+
+struct IoQueue::State {
+    /** The requests run by the IoThreads (used without io_uring) */
+    std::vector<std::future<ssize_t>> futures;
+
+    /** Flag for each slot to indicate a request is in flight */
+    std::vector<bool> busy;
+
+    /** The parameters of a request, to rerun it without io_uring */
+    struct Request {
+        bool write;
+        int fd;
+        char* buf;
+        size_t len;
+        off_t offset;
+    };
+
+#ifdef SQLAIR_USE_IO_URING
+    /** The io_uring file descriptor or -1 if io_uring is not used */
+    int ring = -1;
+
+    /** The result of the completed request in each slot */
+    std::vector<ssize_t> results;
+
+    /** The request in each slot and if it was submitted to the ring */
+    std::vector<Request> requests;
+    std::vector<bool> viaRing;
+
+    /** Flag set if the kernel rejected a read or write with -EINVAL */
+    bool ringRejected = false;
+
+    /** Flag for each slot to indicate its request has completed */
+    std::vector<bool> completed;
+
+    /** The memory mapped submission and completion queues */
+    void* sqMem = MAP_FAILED;
+    size_t sqSize = 0;
+    void* cqMem = MAP_FAILED;
+    size_t cqSize = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqesSize = 0;
+
+    /** Pointers into the mapped queues (see io_uring_setup(2)) */
+    unsigned *sqTail, *sqMask, *sqArray;
+    unsigned *cqHead, *cqTail, *cqMask;
+    io_uring_cqe* cqes;
+
+    /** Set up the ring. Leaves ring at -1 if io_uring is unavailable */
+    void setup(const unsigned depth) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        const int fd = syscall(__NR_io_uring_setup, depth, &params);
+        if (fd < 0) {
+            return;  // Old kernel or disabled. Use threads instead.
+        }
+        sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqSize = params.cq_off.cqes +
+            params.cq_entries * sizeof(io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            sqSize = cqSize = std::max(sqSize, cqSize);
+        }
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        sqMem = mmap(nullptr, sqSize, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        cqMem = (params.features & IORING_FEAT_SINGLE_MMAP) ? sqMem :
+            mmap(nullptr, cqSize, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        void* sqeMem = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        sqes = static_cast<io_uring_sqe*>(sqeMem);
+        ring = fd;
+        if (sqMem == MAP_FAILED || cqMem == MAP_FAILED ||
+            sqeMem == MAP_FAILED) {
+            release();
+            return;
+        }
+        char* sq = static_cast<char*>(sqMem);
+        sqTail  = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask  = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        char* cq = static_cast<char*>(cqMem);
+        cqHead  = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail  = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask  = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes    = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        if (!supportsReadWrite()) {
+            release();  // Kernels before 5.6 lack IORING_OP_READ/WRITE
+            return;
+        }
+        results.resize(depth);
+        completed.resize(depth);
+        requests.resize(depth);
+        viaRing.resize(depth);
+    }
+
+    /** Check (via IORING_REGISTER_PROBE) if reads and writes are supported */
+    bool supportsReadWrite() const {
+        // The probe has a variable number of entries after its header
+        std::vector<io_uring_probe_op> mem(IORING_OP_LAST + 1);
+        auto* probe = reinterpret_cast<io_uring_probe*>(mem.data());
+        static_assert(sizeof(io_uring_probe) % sizeof(io_uring_probe_op) ==
+                      0, "The probe's header must be a whole number of ops");
+        if (syscall(__NR_io_uring_register, ring, IORING_REGISTER_PROBE,
+                    probe, IORING_OP_LAST) < 0) {
+            return false;  // No probe support, i.e., a kernel before 5.6
+        }
+        for (const unsigned op : {IORING_OP_READ, IORING_OP_WRITE}) {
+            if (op > probe->last_op ||
+                !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /** Unmap the queues and close the ring */
+    void release() {
+        if (sqes != MAP_FAILED) {
+            munmap(sqes, sqesSize);
+        }
+        if (cqMem != MAP_FAILED && cqMem != sqMem) {
+            munmap(cqMem, cqSize);
+        }
+        if (sqMem != MAP_FAILED) {
+            munmap(sqMem, sqSize);
+        }
+        if (ring != -1) {
+            ::close(ring);
+        }
+        ring = -1;
+    }
+
+    /** Add a request to the submission queue and submit it */
+    void submit(const unsigned slot, const bool write, const int fd,
+                char* buf, const size_t len, const off_t offset) {
+        // Only this thread produces entries. So a plain read of the tail
+        // suffices; the kernel reads it with acquire semantics.
+        const unsigned tail = *sqTail;
+        const unsigned index = tail & *sqMask;
+        io_uring_sqe& sqe = sqes[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+        sqe.fd = fd;
+        sqe.addr = reinterpret_cast<unsigned long>(buf);
+        sqe.len = len;
+        sqe.off = offset;
+        sqe.user_data = slot;
+        sqArray[index] = index;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+        completed[slot] = false;
+        while (syscall(__NR_io_uring_enter, ring, 1, 0, 0, nullptr, 0) < 0) {
+            if (errno != EINTR && errno != EAGAIN) {
+                throw Exp("io_uring_enter failed: " +
+                          std::string(std::strerror(errno)));
+            }
+        }
+    }
+
+    /** Wait for the request in a given slot, recording other completions */
+    ssize_t wait(const unsigned slot) {
+        while (true) {
+            unsigned head = *cqHead;
+            while (head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+                const io_uring_cqe& cqe = cqes[head & *cqMask];
+                results[cqe.user_data] = cqe.res;
+                completed[cqe.user_data] = true;
+                head++;
+            }
+            __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+            if (completed[slot]) {
+                return results[slot];
+            }
+            if (syscall(__NR_io_uring_enter, ring, 0, 1,
+                        IORING_ENTER_GETEVENTS, nullptr, 0) < 0 &&
+                errno != EINTR) {
+                throw Exp("io_uring_enter failed: " +
+                          std::string(std::strerror(errno)));
+            }
+        }
+    }
+#endif
+};
+
+IoQueue::IoQueue(const unsigned depth) : state(std::make_unique<State>()) {
+    state->futures.resize(depth);
+    state->busy.resize(depth);
+#ifdef SQLAIR_USE_IO_URING
+    state->setup(depth);
+#endif
+}
+
+IoQueue::~IoQueue() {
+    // The buffers of requests in flight are released by the caller. So
+    // wait for all of them.
+    for (unsigned slot = 0; slot < state->busy.size(); slot++) {
+        try {
+            wait(slot);
+        } catch (const std::exception&) {
+            // Nothing more can be done in a destructor
+        }
+    }
+#ifdef SQLAIR_USE_IO_URING
+    state->release();
+#endif
+}
+
+bool IoQueue::usesIoUring() const {
+#ifdef SQLAIR_USE_IO_URING
+    return state->ring != -1;
+#else
+    return false;
+#endif
+}
+
+void IoQueue::submit(const unsigned slot, const bool write, const int fd,
+                     char* buf, const size_t len, const off_t offset) {
+    state->busy.at(slot) = true;
+#ifdef SQLAIR_USE_IO_URING
+    if (state->ring != -1) {
+        state->requests[slot] = {write, fd, buf, len, offset};
+        state->viaRing[slot] = !state->ringRejected;
+        if (state->viaRing[slot]) {
+            state->submit(slot, write, fd, buf, len, offset);
+            return;
+        }
+    }
+#endif
+    state->futures[slot] = IoThreads::get().run(write, fd, buf, len, offset);
+}
+
+ssize_t IoQueue::wait(const unsigned slot) {
+    if (!state->busy.at(slot)) {
+        return 0;
+    }
+    state->busy[slot] = false;
+#ifdef SQLAIR_USE_IO_URING
+    if (state->ring != -1 && state->viaRing[slot]) {
+        const ssize_t result = state->wait(slot);
+        if (result != -EINVAL) {
+            return result;
+        }
+        // The kernel does not support the operation (even though the probe
+        // said so). Rerun it, and use the threads for later requests.
+        state->ringRejected = true;
+        const State::Request& req = state->requests[slot];
+        return transfer(req.write, req.fd, req.buf, req.len, req.offset);
+    }
+#endif
+    return state->futures[slot].get();
+}
+
+// ----------------------------------------------------------------------
+//   AsyncFileReader
+// ----------------------------------------------------------------------
+
+AsyncFileReader::ReadBuf::ReadBuf(const std::string& path) :
+    buffers(QueueDepth), offsets(QueueDepth), requested(QueueDepth),
+    queue(QueueDepth) {
+    fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat info;
+    if (fd == -1 || fstat(fd, &info) != 0) {
+        return;
+    }
+    // Only the data present when the file is opened is read. Rows appended
+    // later are picked up by the watcher (see SQLAir::reloadTable).
+    fileSize = info.st_size;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    for (unsigned slot = 0; slot < QueueDepth; slot++) {
+        buffers[slot].resize(BlockSize);
+        readAhead(slot);
+    }
+}
+
+AsyncFileReader::ReadBuf::~ReadBuf() {
+    for (unsigned slot = 0; slot < QueueDepth; slot++) {
+        queue.wait(slot);
+    }
+    if (fd != -1) {
+        ::close(fd);
+    }
+}
+
+void AsyncFileReader::ReadBuf::readAhead(const unsigned slot) {
+    requested[slot] = std::min<off_t>(BlockSize, fileSize - nextOffset);
+    offsets[slot] = nextOffset;
+    if (requested[slot] > 0) {
+        queue.submit(slot, false, fd, buffers[slot].data(), requested[slot],
+                     nextOffset);
+        nextOffset += requested[slot];
+    }
+}
+
+AsyncFileReader::ReadBuf::int_type AsyncFileReader::ReadBuf::underflow() {
+    if (gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+    }
+    if (blocksRead > 0) {
+        // The previous block has been consumed. Reuse its slot.
+        readAhead((blocksRead - 1) % QueueDepth);
+    }
+    const unsigned slot = blocksRead % QueueDepth;
+    if (requested[slot] == 0) {
+        return traits_type::eof();
+    }
+    char* data = buffers[slot].data();
+    ssize_t got = queue.wait(slot);
+    if (got >= 0 && static_cast<size_t>(got) < requested[slot]) {
+        // Short read. Read the rest synchronously.
+        const ssize_t rest = transfer(false, fd, data + got,
+                                      requested[slot] - got,
+                                      offsets[slot] + got);
+        got = (rest < 0) ? rest : got + rest;
+    }
+    if (got < 0) {
+        throw Exp("Error reading file: " + std::string(std::strerror(-got)));
+    }
+    if (got == 0) {
+        return traits_type::eof();  // File was truncated while reading
+    }
+    blockOffset = offsets[slot];
+    blocksRead++;
+    setg(data, data, data + got);
+    return traits_type::to_int_type(*gptr());
+}
+
+AsyncFileReader::AsyncFileReader(const std::string& path) :
+    std::istream(nullptr), buf(path) {
+    rdbuf(&buf);
+    if (buf.fd == -1) {
+        setstate(std::ios::failbit);
+    }
+    // Report read errors to the caller (instead of a silent end of file)
+    exceptions(std::ios::badbit);
+}
+
+long AsyncFileReader::position() const {
+    return buf.consumed();
+}
+
+// ----------------------------------------------------------------------
+//   AsyncFileWriter
+// ----------------------------------------------------------------------
+
+AsyncFileWriter::WriteBuf::WriteBuf(const std::string& path) :
+    buffers(QueueDepth), offsets(QueueDepth), pending(QueueDepth),
+    queue(QueueDepth) {
+    fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        throw Exp("Unable to open " + path + " for writing: " +
+                  std::strerror(errno));
+    }
+    for (auto& buffer : buffers) {
+        buffer.resize(BlockSize);
+    }
+    setp(buffers[0].data(), buffers[0].data() + BlockSize);
+}
+
+AsyncFileWriter::WriteBuf::~WriteBuf() {
+    for (unsigned slot = 0; slot < QueueDepth; slot++) {
+        queue.wait(slot);
+    }
+    if (fd != -1) {
+        ::close(fd);
+    }
+}
+
+void AsyncFileWriter::WriteBuf::writeBlock() {
+    const size_t len = pptr() - pbase();
+    if (len == 0) {
+        return;
+    }
+    queue.submit(slot, true, fd, buffers[slot].data(), len, offset);
+    offsets[slot] = offset;
+    pending[slot] = len;
+    offset += len;
+    // Fill the next slot once its previous write (if any) has finished
+    slot = (slot + 1) % QueueDepth;
+    finishWrite(slot);
+    setp(buffers[slot].data(), buffers[slot].data() + BlockSize);
+}
+
+void AsyncFileWriter::WriteBuf::finishWrite(const unsigned slot) {
+    if (pending[slot] == 0) {
+        return;
+    }
+    ssize_t done = queue.wait(slot);
+    if (done >= 0 && static_cast<size_t>(done) < pending[slot]) {
+        // Short write. Write the rest synchronously.
+        const ssize_t rest = transfer(true, fd, buffers[slot].data() + done,
+                                      pending[slot] - done,
+                                      offsets[slot] + done);
+        done = (rest < 0) ? rest : done + rest;
+    }
+    pending[slot] = 0;
+    if (done < 0) {
+        throw Exp("Error writing file: " + std::string(std::strerror(-done)));
+    }
+}
+
+AsyncFileWriter::WriteBuf::int_type
+AsyncFileWriter::WriteBuf::overflow(int_type ch) {
+    writeBlock();
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+AsyncFileWriter::AsyncFileWriter(const std::string& path) :
+    std::ostream(nullptr), buf(path) {
+    rdbuf(&buf);
+    // Report write errors to the caller (instead of just setting badbit)
+    exceptions(std::ios::badbit);
+}
+
+void AsyncFileWriter::close() {
+    buf.writeBlock();
+    for (unsigned slot = 0; slot < QueueDepth; slot++) {
+        buf.finishWrite(slot);
+    }
+    if (::close(buf.fd) != 0) {
+        buf.fd = -1;
+        throw Exp("Error closing file: " + std::string(std::strerror(errno)));
+    }
+    buf.fd = -1;
+}
@@ -0,0 +1,231 @@
+#ifndef ASYNC_FILE_H
+#define ASYNC_FILE_H
+
+/*
+ * Streams to read and write local files using large asynchronous I/O
+ * requests. Several block-sized reads (or writes) are kept in flight so
+ * that disk I/O overlaps with parsing (or formatting) of the data. If
+ * SQLAir is compiled with -DSQLAIR_USE_IO_URING (and linked with
+ * -luring), the requests are submitted via Linux's io_uring on kernels
+ * that support its read and write operations (5.6 or later). Otherwise,
+ * each request is a pread/pwrite run by a small, fixed pool of threads.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include <sys/types.h>
+
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+/**
+ * A queue of asynchronous reads/writes on files. Each request is placed in
+ * a numbered slot and the caller waits for the request in a given slot to
+ * complete. An IoQueue is used by one thread at a time.
+ */
+class IoQueue {
+public:
+    /**
+     * Creates a queue.
+     *
+     * @param depth The maximum number of requests in flight, i.e., the
+     * number of slots.
+     */
+    explicit IoQueue(const unsigned depth);
+
+    /**
+     * Waits for any requests in flight and releases the queue.
+     */
+    ~IoQueue();
+
+    /**
+     * Start a read or write in a given slot. The slot must not already
+     * have a request in flight.
+     *
+     * @param slot The slot for the request, in the range [0, depth).
+     *
+     * @param write If this flag is true a pwrite is performed. Otherwise a
+     * pread is performed.
+     *
+     * @param fd The file descriptor of the file.
+     *
+     * @param buf The buffer for the data. It must remain valid until the
+     * request completes.
+     *
+     * @param len The number of bytes to read or write.
+     *
+     * @param offset The offset in the file.
+     */
+    void submit(const unsigned slot, const bool write, const int fd,
+                char* buf, const size_t len, const off_t offset);
+
+    /**
+     * Wait for the request in a given slot to complete.
+     *
+     * @param slot The slot whose request is to be waited for.
+     *
+     * @return The number of bytes read or written or a negative error
+     * code (-errno) on errors.
+     */
+    ssize_t wait(const unsigned slot);
+
+    /**
+     * Determine if this queue uses io_uring (instead of threads).
+     *
+     * @return This method returns true if requests are run via io_uring.
+     */
+    bool usesIoUring() const;
+
+private:
+    /** The implementation specific state of the queue */
+    struct State;
+
+    /** The state of this queue */
+    std::unique_ptr<State> state;
+};
+
+/**
+ * An input stream that reads a local file via several large reads in
+ * flight (see IoQueue). This is used in place of a std::ifstream to load
+ * large CSV files.
+ */
+class AsyncFileReader : public std::istream {
+public:
+    /**
+     * Opens a file and starts reading the first few blocks. If the file
+     * could not be opened, the stream's failbit is set.
+     *
+     * @param path The path to the file to be read.
+     */
+    explicit AsyncFileReader(const std::string& path);
+
+    /**
+     * Obtain the number of bytes consumed from this stream so far.
+     *
+     * @return The offset in the file of the next byte to be read.
+     */
+    long position() const;
+
+    /** The size of each read request */
+    static constexpr size_t BlockSize = 1024 * 1024;
+
+    /** The number of read requests kept in flight */
+    static constexpr unsigned QueueDepth = 4;
+
+private:
+    /** The stream buffer that hands out blocks as they are read */
+    class ReadBuf : public std::streambuf {
+    public:
+        explicit ReadBuf(const std::string& path);
+        ~ReadBuf();
+
+        /** Start reading the next block into a given slot */
+        void readAhead(const unsigned slot);
+
+        /** The offset in the file of the next byte to be consumed */
+        long consumed() const { return blockOffset + (gptr() - eback()); }
+
+        /** The file descriptor or -1 if the file could not be opened */
+        int fd = -1;
+
+        /** The size of the file */
+        off_t fileSize = 0;
+
+        /** The offset of the next block to be requested */
+        off_t nextOffset = 0;
+
+        /** The offset in the file of the start of the current block */
+        off_t blockOffset = 0;
+
+        /** The number of blocks handed out so far */
+        unsigned long blocksRead = 0;
+
+        /** The buffer for each slot, the offset and size read into it */
+        std::vector<std::vector<char>> buffers;
+        std::vector<off_t> offsets;
+        std::vector<size_t> requested;
+
+        /** The queue of read requests */
+        IoQueue queue;
+
+    protected:
+        int_type underflow() override;
+    };
+
+    /** The buffer from where this stream reads its data */
+    ReadBuf buf;
+};
+
+/**
+ * An output stream that writes a local file via several large writes in
+ * flight (see IoQueue). This is used in place of a std::ofstream to save
+ * large CSV files. The file is truncated when it is opened.
+ */
+class AsyncFileWriter : public std::ostream {
+public:
+    /**
+     * Opens (creates or truncates) a file for writing.
+     *
+     * @param path The path to the file to be written.
+     *
+     * @exception Exp This method throws an exception if the file could not
+     * be opened.
+     */
+    explicit AsyncFileWriter(const std::string& path);
+
+    /**
+     * Waits for all the writes to complete and closes the file.
+     *
+     * @exception Exp This method throws an exception if any write failed.
+     */
+    void close();
+
+    /** The size of each write request */
+    static constexpr size_t BlockSize = 1024 * 1024;
+
+    /** The number of write requests kept in flight */
+    static constexpr unsigned QueueDepth = 4;
+
+private:
+    /** The stream buffer that writes each full block asynchronously */
+    class WriteBuf : public std::streambuf {
+    public:
+        explicit WriteBuf(const std::string& path);
+        ~WriteBuf();
+
+        /** Write the current block and switch to the next slot */
+        void writeBlock();
+
+        /** Wait for the write in a given slot, if any, to complete */
+        void finishWrite(const unsigned slot);
+
+        /** The file descriptor */
+        int fd = -1;
+
+        /** The offset in the file of the next block */
+        off_t offset = 0;
+
+        /** The slot whose buffer is currently being filled */
+        unsigned slot = 0;
+
+        /** The buffer for each slot, the offset and size written from it */
+        std::vector<std::vector<char>> buffers;
+        std::vector<off_t> offsets;
+        std::vector<size_t> pending;
+
+        /** The queue of write requests */
+        IoQueue queue;
+
+    protected:
+        int_type overflow(int_type ch) override;
+    };
+
+    /** The buffer to where this stream writes its data */
+    WriteBuf buf;
+};
+
+#endif /* ASYNC_FILE_H */
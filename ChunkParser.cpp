@@ -0,0 +1,74 @@
+/*
+ * Implementation of the parallel parser for chunks of CSV data.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include "ChunkParser.h"
+
+#include <exception>
+#include <sstream>
+#include <thread>
+#include "AllocTracker.h"
+#include "Helper.h"
+
+void ChunkParser::load(CSV& csv, std::vector<std::string>& chunks) {
+    if (chunks.empty()) {
+        throw Exp("No data to load");
+    }
+    // A chunk without a newline is entirely in the middle of a row. So
+    // merge it with the previous chunk.
+    for (size_t i = chunks.size() - 1; (i > 0); i--) {
+        if (chunks[i].find('\n') == std::string::npos) {
+            chunks[i - 1] += chunks[i];
+            chunks.erase(chunks.begin() + i);
+        }
+    }
+    // Re-synchronize: the partial row at the start of each chunk is moved
+    // to the end of the previous chunk.
+    for (size_t i = 1; (i < chunks.size()); i++) {
+        const size_t rowStart = chunks[i].find('\n') + 1;
+        chunks[i - 1].append(chunks[i], 0, rowStart);
+        chunks[i].erase(0, rowStart);
+    }
+    // Each chunk, except the first one, is prefixed with the header line
+    // so that it can be parsed by the standard loader.
+    const std::string header = chunks[0].substr(0,
+                                                chunks[0].find('\n') + 1);
+    std::vector<CSV> parts(chunks.size());
+    std::vector<std::exception_ptr> errors(chunks.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 0; (i < chunks.size()); i++) {
+        threads.emplace_back(AllocTracker::wrap([&, i] {
+            try {
+                std::istringstream data(i == 0 ? std::move(chunks[i]) :
+                                        header + chunks[i]);
+                chunks[i].clear();
+                chunks[i].shrink_to_fit();
+                parts[i].load(data);
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        }));
+    }
+    for (auto& thr : threads) {
+        thr.join();
+    }
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+    // Stitch the rows together in order
+    size_t numRows = 0;
+    for (const auto& part : parts) {
+        numRows += part.size();
+    }
+    csv.move(parts[0]);
+    csv.reserve(numRows);
+    for (size_t i = 1; (i < parts.size()); i++) {
+        for (auto& row : parts[i]) {
+            csv.emplace_back(std::move(row));
+        }
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef CHUNK_PARSER_H
+#define CHUNK_PARSER_H
+
+/*
+ * Parse CSV data that is split into several chunks (e.g., the byte ranges
+ * of a file downloaded in parallel) using a thread per chunk. Chunk
+ * boundaries need not coincide with row boundaries: each chunk is
+ * re-synchronized to start at a row boundary before it is parsed.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include <string>
+#include <vector>
+#include "CSV.h"
+
+/**
+ * Static helper methods to parse chunks of CSV data in parallel. Similar to
+ * the Helper class, this class is never instantiated.
+ */
+class ChunkParser {
+public:
+    /**
+     * Loads CSV data that has been split into consecutive chunks. The first
+     * chunk must start with the header line. Each chunk is parsed by a
+     * separate thread using the standard loader (see CSV::load) and the
+     * rows are appended to the CSV in the same order as in the data.
+     *
+     * @note Rows must not contain newlines (which is also the case with
+     * CSV::load).
+     *
+     * @param csv The empty CSV into which the data is to be loaded.
+     *
+     * @param chunks The chunks of data, in order. The chunks are modified
+     * by this method.
+     *
+     * @exception Exp This method rethrows any exception that occurred when
+     * parsing the chunks.
+     */
+    static void load(CSV& csv, std::vector<std::string>& chunks);
+
+private:
+    /**
+     * This class is never meant to be instantiated. Hence the constructor
+     * is intentionally private.
+     */
+    ChunkParser();
+};
+
+#endif /* CHUNK_PARSER_H */
@@ -0,0 +1,159 @@
+/*
+ * Implementation of the parallel writer for CSV data.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include "CsvWriter.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include "AllocTracker.h"
+#include "Helper.h"
+
+void CsvWriter::save(const TableVersion& version, std::ostream& os,
+                     const std::string& delim, const bool quote,
+                     const std::string& nl, int numThreads) {
+    std::vector<Block> blocks;
+    for (const auto& segment : version.getSegments()) {
+        blocks.push_back({segment.get(), 0, segment->size()});
+    }
+    write(version.getColumnNames(), blocks, os, delim, quote, nl,
+          numThreads);
+}
+
+void CsvWriter::write(const StrVec& columns, const std::vector<Block>& blocks,
+                      std::ostream& os, const std::string& delim,
+                      const bool quote, const std::string& nl,
+                      int numThreads) {
+    if (!os.good()) {
+        throw Exp("The supplied stream was not good.");
+    }
+    // Use at most one thread per core
+    const int numCores = std::max(1u, std::thread::hardware_concurrency());
+    if (numThreads <= 0 || numThreads > numCores) {
+        numThreads = numCores;
+    }
+    // The header line is formatted just like the rows
+    TableVersion::Segment header(1);
+    header[0].assign(columns.begin(), columns.end());
+    os << format(header, 0, 1, delim, quote, nl);
+    numThreads = std::min<size_t>(numThreads, blocks.size());
+    if (numThreads <= 1) {
+        for (const Block& block : blocks) {
+            const std::string data = format(*block.rows, block.start,
+                                            block.end, delim, quote, nl);
+            if (!os.write(data.data(), data.size())) {
+                throw Exp("Error writing CSV data");
+            }
+        }
+        return;
+    }
+    // The formatted blocks, the next block to be formatted, and the number
+    // of blocks written so far are shared with the pool of threads.
+    const size_t window = 2 * numThreads;
+    std::vector<std::string> data(blocks.size());
+    std::vector<bool> ready(blocks.size());
+    size_t next = 0, written = 0;
+    bool stopping = false;
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::condition_variable changed;
+    const auto formatBlocks = [&] {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            changed.wait(lock, [&] { return stopping ||
+                next == blocks.size() || next < written + window; });
+            if (stopping || next == blocks.size()) {
+                return;
+            }
+            const size_t idx = next++;
+            lock.unlock();
+            std::string buf;
+            std::exception_ptr exp;
+            try {
+                buf = format(*blocks[idx].rows, blocks[idx].start,
+                             blocks[idx].end, delim, quote, nl);
+            } catch (...) {
+                exp = std::current_exception();
+            }
+            lock.lock();
+            if (exp) {
+                error = exp;
+                stopping = true;
+            }
+            data[idx] = std::move(buf);
+            ready[idx] = true;
+            changed.notify_all();
+        }
+    };
+    std::vector<std::thread> pool;
+    for (int i = 0; (i < numThreads); i++) {
+        pool.emplace_back(AllocTracker::wrap(formatBlocks));
+    }
+    // Write the blocks in order, each with one large write
+    bool ok = true;
+    for (size_t idx = 0; ok && (idx < blocks.size()); idx++) {
+        std::string buf;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&] { return ready[idx] || error; });
+            if (error) {
+                break;
+            }
+            buf = std::move(data[idx]);
+            written++;
+        }
+        changed.notify_all();
+        ok = static_cast<bool>(os.write(buf.data(), buf.size()));
+    }
+    {
+        std::scoped_lock<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+    for (auto& thr : pool) {
+        thr.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    if (!ok) {
+        throw Exp("Error writing CSV data");
+    }
+}
+
+std::string CsvWriter::format(const TableVersion::Segment& rows, size_t start,
+                              size_t end, const std::string& delim,
+                              const bool quote, const std::string& nl) {
+    // Size the buffer once to avoid repeated reallocation
+    size_t size = 0;
+    for (size_t i = start; (i < end); i++) {
+        for (size_t j = 0; (j < rows[i].size()); j++) {
+            size += rows[i][j].size() + delim.size() + 2;
+        }
+        size += nl.size();
+    }
+    std::string buf;
+    buf.reserve(size);
+    for (size_t i = start; (i < end); i++) {
+        for (size_t j = 0; (j < rows[i].size()); j++) {
+            if (j > 0) {
+                buf += delim;
+            }
+            if (quote) {
+                buf += '"';
+            }
+            buf += rows[i][j];
+            if (quote) {
+                buf += '"';
+            }
+        }
+        buf += nl;
+    }
+    return buf;
+}
@@ -0,0 +1,111 @@
+#ifndef CSV_WRITER_H
+#define CSV_WRITER_H
+
+/*
+ * A parallel writer for CSV data. Blocks of rows are formatted into
+ * separate buffers by several threads and the buffers are written, in
+ * order, using large sequential writes. The output is identical to that of
+ * CSV::save.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include "CSV.h"
+#include "TableVersion.h"
+
+/**
+ * Static helper methods to format and write CSV data. Similar to the
+ * Helper class, this class is never instantiated.
+ */
+class CsvWriter {
+public:
+    /**
+     * Writes a version of a CSV to a given stream using several threads to
+     * format the rows. Each segment of the version is formatted as one
+     * block. The output is the same as CSV::save.
+     *
+     * @param version The immutable version of the CSV to be written.
+     *
+     * @param os The output stream to where the data is to be written.
+     *
+     * @param delim The delimiter to use between each column.
+     *
+     * @param quote If this flag is true then each value is quoted.
+     *
+     * @param nl The string to be used for new lines.
+     *
+     * @param numThreads The number of threads to be used to format rows.
+     * If this value is zero, then the number of cores is used. At most one
+     * thread per core is used.
+     *
+     * @exception Exp This method throws an exception if the stream is not
+     * good or the data could not be written.
+     */
+    static void save(const TableVersion& version, std::ostream& os,
+                     const std::string& delim = ",", const bool quote = true,
+                     const std::string& nl = "\n", int numThreads = 0);
+
+    /** The number of rows formatted into each buffer */
+    static constexpr size_t BlockRows = 16 * 1024;
+
+private:
+    /** A range of rows to be formatted as one block */
+    struct Block {
+        /** The rows, i.e., a segment of a TableVersion */
+        const TableVersion::Segment* rows;
+        /** The index of the first row of the block */
+        size_t start;
+        /** The index after the last row of the block */
+        size_t end;
+    };
+
+    /**
+     * Formats blocks of rows on a pool of threads and writes them in order.
+     * The threads format at most 2 blocks per thread ahead of the block
+     * being written, which bounds the memory used for the buffers.
+     *
+     * @param columns The column names written in the header line.
+     *
+     * @param blocks The blocks of rows to be written.
+     *
+     * The other parameters are the same as save().
+     */
+    static void write(const StrVec& columns, const std::vector<Block>& blocks,
+                      std::ostream& os, const std::string& delim,
+                      const bool quote, const std::string& nl,
+                      int numThreads);
+
+    /**
+     * Appends a range of rows, formatted in the same manner as CSV::save,
+     * to a buffer.
+     *
+     * @param rows The rows (e.g., of a segment) to be formatted.
+     *
+     * @param start The index of the first row to be formatted.
+     *
+     * @param end The index after the last row to be formatted.
+     *
+     * @param delim The delimiter to use between each column.
+     *
+     * @param quote If this flag is true then each value is quoted.
+     *
+     * @param nl The string to be used for new lines.
+     *
+     * @return The formatted rows.
+     */
+    static std::string format(const TableVersion::Segment& rows, size_t start,
+                              size_t end,
+                              const std::string& delim, const bool quote,
+                              const std::string& nl);
+
+    /**
+     * This class is never meant to be instantiated. Hence the constructor
+     * is intentionally private.
+     */
+    CsvWriter();
+};
+
+#endif /* CSV_WRITER_H */
@@ -0,0 +1,130 @@
+/*
+ * Implementation of the inotify-based watcher for changes to CSV files.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include "FileWatcher.h"
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <filesystem>
+#include <vector>
+
+FileWatcher::FileWatcher(const Handler& handler) : handler(handler) {
+}
+
+FileWatcher::~FileWatcher() {
+    if (thread.joinable()) {
+        // Wake up the background thread and wait for it to stop
+        const char stop = 0;
+        if (write(stopPipe[1], &stop, 1) == 1) {
+            thread.join();
+        } else {
+            thread.detach();
+        }
+    }
+    for (int fd : {inotifyFd, stopPipe[0], stopPipe[1]}) {
+        if (fd != -1) {
+            close(fd);
+        }
+    }
+}
+
+bool FileWatcher::watch(const std::string& path) {
+    std::scoped_lock<std::mutex> lock(mutex);
+    if (inotifyFd == -1) {
+        // First file to be watched. Setup inotify and start the thread.
+        inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotifyFd == -1) {
+            return false;
+        }
+        if (pipe(stopPipe) == -1) {
+            // Reset so that a later call tries again
+            close(inotifyFd);
+            inotifyFd = -1;
+            stopPipe[0] = stopPipe[1] = -1;
+            return false;
+        }
+        thread = std::thread(&FileWatcher::run, this);
+    }
+    const std::filesystem::path file(path);
+    const std::string dir = (file.has_parent_path() ?
+                             file.parent_path().string() : ".");
+    // Watch for files that are written or replaced (via a rename)
+    const int wd = inotify_add_watch(inotifyFd, dir.c_str(),
+                                     IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO);
+    if (wd == -1) {
+        return false;
+    }
+    // Each watch is keyed by its descriptor and the full path, as files
+    // with the same name may be watched via different paths.
+    auto& files = dirs[wd];
+    const auto [first, last] = files.equal_range(file.filename().string());
+    if (std::find_if(first, last, [&path](const auto& entry) {
+            return entry.second == path; }) == last) {
+        files.emplace(file.filename().string(), path);
+    }
+    return true;
+}
+
+void FileWatcher::run() {
+    // Paths that have changed but whose handler has not yet been called
+    std::unordered_map<std::string, Deadline> changed;
+    alignas(inotify_event) char buf[4096];
+    while (true) {
+        // Wait for more changes only until the earliest deadline, if any
+        int timeout = -1;
+        if (!changed.empty()) {
+            auto due = Clock::time_point::max();
+            for (const auto& entry : changed) {
+                due = std::min(due, entry.second.due());
+            }
+            const auto wait = std::chrono::ceil<std::chrono::milliseconds>(
+                due - Clock::now()).count();
+            timeout = std::max<long>(wait, 0);
+        }
+        pollfd fds[2] = {{inotifyFd, POLLIN, 0}, {stopPipe[0], POLLIN, 0}};
+        const int ready = poll(fds, 2, timeout);
+        if (ready > 0 && fds[1].revents != 0) {
+            return;  // Stopping
+        }
+        // Read the events and record the paths of the watched files
+        for (ssize_t len; (len = read(inotifyFd, buf, sizeof(buf))) > 0;) {
+            std::scoped_lock<std::mutex> lock(mutex);
+            const auto now = Clock::now();
+            for (char* ptr = buf; ptr < buf + len;) {
+                const auto* event = reinterpret_cast<inotify_event*>(ptr);
+                ptr += sizeof(inotify_event) + event->len;
+                const auto dir = dirs.find(event->wd);
+                if (dir == dirs.end() || event->len == 0) {
+                    continue;
+                }
+                const auto [first, last] = dir->second.equal_range(
+                    event->name);
+                for (auto file = first; file != last; ++file) {
+                    // The quiet period restarts with every change but the
+                    // latest time is set by the first change.
+                    const auto quiet = now +
+                        std::chrono::milliseconds(QuietMillis);
+                    const auto entry = changed.try_emplace(file->second,
+                        Deadline{quiet, now +
+                            std::chrono::milliseconds(MaxDelayMillis)});
+                    entry.first->second.quiet = quiet;
+                }
+            }
+        }
+        // Call the handler for the files whose deadline has passed
+        const auto now = Clock::now();
+        for (auto entry = changed.begin(); entry != changed.end();) {
+            if (entry->second.due() <= now) {
+                handler(entry->first);
+                entry = changed.erase(entry);
+            } else {
+                ++entry;
+            }
+        }
+    }
+}
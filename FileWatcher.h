@@ -0,0 +1,117 @@
+#ifndef FILE_WATCHER_H
+#define FILE_WATCHER_H
+
+/*
+ * A background watcher that uses Linux's inotify API to detect changes to
+ * the local CSV files that have been loaded. The directory containing each
+ * file is watched (rather than the file itself) so that files that are
+ * replaced by renaming a new file over them are also detected.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+/**
+ * Watches a set of files and calls a handler (from a background thread)
+ * whenever a file changes. Bursts of changes (e.g., a file being written
+ * in many small blocks) are coalesced so that the handler is called once
+ * after the file has been quiet for a short while. Each file is tracked
+ * separately, and a file that keeps changing (e.g., a busy feed) is handled
+ * at least once every MaxDelayMillis.
+ */
+class FileWatcher {
+public:
+    /**
+     * The type of the function called when a file changes. The function
+     * is called with the path used in the call to watch().
+     */
+    using Handler = std::function<void(const std::string& path)>;
+
+    /**
+     * Creates a watcher. The background thread is started on the first
+     * call to watch().
+     *
+     * @param handler The function to be called when a watched file
+     * changes.
+     */
+    explicit FileWatcher(const Handler& handler);
+
+    /**
+     * Stops the background thread and releases the inotify resources.
+     */
+    ~FileWatcher();
+
+    /**
+     * Start watching a file. Watching a file that is already being watched
+     * has no effect.
+     *
+     * @param path The path to the file to be watched.
+     *
+     * @return This method returns false if the file could not be watched
+     * (e.g., inotify is not available).
+     */
+    bool watch(const std::string& path);
+
+    /** The time (in milliseconds) a file must be quiet before the handler
+     * is called. */
+    static constexpr int QuietMillis = 100;
+
+    /** The maximum time (in milliseconds) between the first change to a
+     * file and the call to the handler, even if the file is not quiet. */
+    static constexpr int MaxDelayMillis = 2000;
+
+private:
+    /** The clock used for the deadlines of changed files */
+    using Clock = std::chrono::steady_clock;
+
+    /** The times at which the handler is to be called for a changed file */
+    struct Deadline {
+        /** The time at which the file will have been quiet long enough */
+        Clock::time_point quiet;
+
+        /** The latest time, based on the first change to the file */
+        Clock::time_point latest;
+
+        /** Obtain the time at which the handler is to be called. */
+        Clock::time_point due() const { return std::min(quiet, latest); }
+    };
+
+    /**
+     * The method run by the background thread. It reads events from
+     * inotify and calls the handler for the changed files.
+     */
+    void run();
+
+    /** The function called when a watched file changes */
+    Handler handler;
+
+    /** The inotify file descriptor, or -1 if inotify is not initialized */
+    int inotifyFd = -1;
+
+    /** A pipe used to wake up the background thread when stopping */
+    int stopPipe[2] = {-1, -1};
+
+    /** The watched directories, indexed by their inotify watch descriptor.
+     * For each directory, the watched file names are mapped to the full
+     * paths passed to watch(). A name can map to several paths, e.g.,
+     * "x.csv" and "./x.csv", or the same name in directories that inotify
+     * reports with one watch descriptor. Each path is handled separately. */
+    std::unordered_map<int, std::unordered_multimap<std::string,
+                                                    std::string>> dirs;
+
+    /** Mutex to serialize access to dirs */
+    std::mutex mutex;
+
+    /** The background thread that reads inotify events */
+    std::thread thread;
+};
+
+#endif /* FILE_WATCHER_H */
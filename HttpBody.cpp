@@ -0,0 +1,184 @@
+/*
+ * Implementation of the streaming decoder for bodies of HTTP responses.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include "HttpBody.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <string>
+#include "CSV.h"
+#include "Helper.h"
+
+#ifdef SQLAIR_USE_ZLIB
+#include <zlib.h>
+
+/**
+ * A stream buffer that inflates data compressed with gzip or deflate (as
+ * used by web-servers) as it is read. Some servers send "deflate" bodies
+ * without the zlib header. Such bodies are inflated as raw deflate data.
+ */
+class InflateBuf : public std::streambuf {
+public:
+    InflateBuf(std::streambuf& source, const bool deflate) : source(source),
+        in(HttpBody::BufferSize), out(HttpBody::BufferSize),
+        tryRaw(deflate) {
+        // 15 + 32 = maximum window with automatic gzip/zlib detection
+        if (inflateInit2(&zs, 15 + 32) != Z_OK) {
+            throw Exp("Unable to initialize zlib");
+        }
+    }
+
+    ~InflateBuf() { inflateEnd(&zs); }
+
+protected:
+    int_type underflow() override {
+        while (!finished) {
+            if (zs.avail_in == 0) {
+                const auto len = source.sgetn(in.data(), in.size());
+                if (len == 0) {
+                    throw Exp("Compressed data is truncated");
+                }
+                zs.next_in = reinterpret_cast<Bytef*>(in.data());
+                zs.avail_in = inLen = len;
+            }
+            zs.next_out = reinterpret_cast<Bytef*>(out.data());
+            zs.avail_out = out.size();
+            const int rc = inflate(&zs, Z_NO_FLUSH);
+            if (rc == Z_DATA_ERROR && tryRaw && zs.total_out == 0 &&
+                zs.total_in <= inLen) {
+                // The zlib header check failed at the start of the body.
+                // Inflate the same bytes again as raw deflate data.
+                tryRaw = false;
+                if (inflateReset2(&zs, -MAX_WBITS) != Z_OK) {
+                    throw Exp("Unable to initialize zlib");
+                }
+                zs.next_in = reinterpret_cast<Bytef*>(in.data());
+                zs.avail_in = inLen;
+                continue;
+            }
+            tryRaw = false;
+            if (rc != Z_OK && rc != Z_STREAM_END) {
+                throw Exp(std::string("Error inflating data: ") +
+                          (zs.msg != nullptr ? zs.msg : "unknown"));
+            }
+            finished = (rc == Z_STREAM_END);
+            const size_t len = out.size() - zs.avail_out;
+            if (len > 0) {
+                setg(out.data(), out.data(), out.data() + len);
+                return traits_type::to_int_type(out[0]);
+            }
+        }
+        return traits_type::eof();
+    }
+
+private:
+    /** The stream buffer from where compressed data is read */
+    std::streambuf& source;
+
+    /** The zlib state */
+    z_stream zs = {};
+
+    /** The buffers for the compressed and inflated data */
+    std::vector<char> in, out;
+
+    /** The number of bytes read into the in buffer by the last read */
+    size_t inLen = 0;
+
+    /** Flag to retry as raw deflate data if the zlib header is invalid */
+    bool tryRaw;
+
+    /** Flag set at the end of the compressed data */
+    bool finished = false;
+};
+#endif
+
+HttpBody::HttpBody(std::istream& socket, const HttpClient::Response& resp) :
+    std::istream(nullptr), framed(socket, resp) {
+    const std::string encoding =
+        CSV::toLower(resp.header("content-encoding"));
+    if (encoding.empty() || encoding == "identity") {
+        rdbuf(&framed);
+    } else if (encoding == "gzip" || encoding == "deflate") {
+#ifdef SQLAIR_USE_ZLIB
+        inflater = std::make_unique<InflateBuf>(framed,
+                                                encoding == "deflate");
+        rdbuf(inflater.get());
+#else
+        throw Exp("Content-Encoding " + encoding + " requires compiling "
+                  "with -DSQLAIR_USE_ZLIB");
+#endif
+    } else {
+        throw Exp("Unsupported Content-Encoding " + encoding);
+    }
+    // Report decoding errors as exceptions instead of a premature end
+    exceptions(std::ios::badbit);
+}
+
+bool HttpBody::canInflate() {
+#ifdef SQLAIR_USE_ZLIB
+    return true;
+#else
+    return false;
+#endif
+}
+
+HttpBody::FramedBuf::FramedBuf(std::istream& socket,
+                               const HttpClient::Response& resp) :
+    socket(socket), buffer(BufferSize) {
+    chunked = (CSV::toLower(resp.header("transfer-encoding")).find(
+        "chunked") != std::string::npos);
+    // A chunked body ignores the Content-Length (see RFC 7230, 3.3.3)
+    remaining = (chunked ? 0 : resp.contentLength());
+}
+
+void HttpBody::FramedBuf::nextChunk() {
+    std::string line;
+    if (!std::getline(socket, line)) {
+        throw Exp("Chunked response is truncated");
+    }
+    if (Helper::trim(line).empty() && !std::getline(socket, line)) {
+        // Skipped the CRLF at the end of the previous chunk
+        throw Exp("Chunked response is truncated");
+    }
+    // The size is in hex and may be followed by ";extensions"
+    char* end = nullptr;
+    errno = 0;
+    const long size = std::strtol(line.c_str(), &end, 16);
+    if (end == line.c_str() || errno == ERANGE || size < 0 ||
+        (*end != '\0' && *end != ';' && *end != '\r' && *end != ' ' &&
+         *end != '\t')) {
+        throw Exp("Invalid chunk size " + Helper::trim(line));
+    }
+    remaining = size;
+    if (remaining == 0) {
+        // Last chunk. Skip the optional trailers until an empty line.
+        while (std::getline(socket, line) && !Helper::trim(line).empty()) {
+        }
+        chunked = false;
+    }
+}
+
+HttpBody::FramedBuf::int_type HttpBody::FramedBuf::underflow() {
+    if (chunked && remaining == 0) {
+        nextChunk();
+    }
+    if (remaining == 0) {
+        return traits_type::eof();  // End of the body
+    }
+    const long toRead = (remaining < 0 ? buffer.size() :
+                         std::min<long>(remaining, buffer.size()));
+    const long len = socket.rdbuf()->sgetn(buffer.data(), toRead);
+    if (len == 0) {
+        if (remaining < 0) {
+            return traits_type::eof();  // The server closed the connection
+        }
+        throw Exp("Response is truncated");
+    }
+    remaining -= (remaining < 0 ? 0 : len);
+    setg(buffer.data(), buffer.data(), buffer.data() + len);
+    return traits_type::to_int_type(buffer[0]);
+}
@@ -0,0 +1,88 @@
+#ifndef HTTP_BODY_H
+#define HTTP_BODY_H
+
+/*
+ * A streaming decoder for the body of a HTTP/1.1 response. The decoder
+ * handles the framing of the body ("Transfer-Encoding: chunked", a
+ * "Content-Length", or data until the connection is closed) and, if
+ * SQLAir is compiled with -DSQLAIR_USE_ZLIB (and linked with -lz), also
+ * inflates bodies with "Content-Encoding: gzip" (or deflate) on the fly.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include <istream>
+#include <memory>
+#include <streambuf>
+#include <vector>
+#include "HttpClient.h"
+
+/**
+ * An input stream that provides the decoded body of a HTTP response. Errors
+ * (e.g., a truncated or corrupt body) are reported by throwing exceptions
+ * rather than just setting the stream's state, so that partial data is
+ * never mistaken for a complete body.
+ */
+class HttpBody : public std::istream {
+public:
+    /**
+     * Creates a stream to read the body of a response.
+     *
+     * @param socket The stream from where the response is read. The status
+     * line and headers must have already been read (see
+     * HttpClient::setupDownload).
+     *
+     * @param resp The status and headers of the response.
+     *
+     * @exception Exp This method throws an exception if the response uses
+     * an encoding that is not supported.
+     */
+    HttpBody(std::istream& socket, const HttpClient::Response& resp);
+
+    /**
+     * Determine if compressed bodies can be decoded, i.e., if SQLAir was
+     * compiled with -DSQLAIR_USE_ZLIB.
+     *
+     * @return This method returns true if compression is supported.
+     */
+    static bool canInflate();
+
+    /** The size of the buffers used to decode the body */
+    static constexpr size_t BufferSize = 64 * 1024;
+
+private:
+    /** The stream buffer that removes the framing of the body */
+    class FramedBuf : public std::streambuf {
+    public:
+        FramedBuf(std::istream& socket, const HttpClient::Response& resp);
+
+    protected:
+        int_type underflow() override;
+
+    private:
+        /** Read the size of the next chunk in a chunked body */
+        void nextChunk();
+
+        /** The stream from where the raw body is read */
+        std::istream& socket;
+
+        /** Flag to indicate if the body uses chunked encoding */
+        bool chunked = false;
+
+        /** The bytes remaining in the current chunk (or the body). A value
+         * of -1 indicates the body ends when the connection is closed. */
+        long remaining = -1;
+
+        /** The buffer for the decoded data */
+        std::vector<char> buffer;
+    };
+
+    /** The framing decoder. It is used directly if the body is not
+     * compressed. */
+    FramedBuf framed;
+
+    /** The decompressor, if the body is compressed */
+    std::unique_ptr<std::streambuf> inflater;
+};
+
+#endif /* HTTP_BODY_H */
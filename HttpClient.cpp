@@ -0,0 +1,153 @@
+/*
+ * Implementation of the helper methods to download data from web-servers.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include "HttpClient.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include "CSV.h"
+#include "Helper.h"
+#include "HttpBody.h"
+
+std::string HttpClient::Response::header(const std::string& name) const {
+    const auto entry = headers.find(name);
+    return (entry != headers.end() ? entry->second : "");
+}
+
+long HttpClient::Response::contentLength() const {
+    const std::string len = header("content-length");
+    if (len.empty()) {
+        return -1;
+    }
+    char* end = nullptr;
+    errno = 0;
+    const long num = std::strtol(len.c_str(), &end, 10);
+    if (end == len.c_str() || *end != '\0' || errno == ERANGE || num < 0) {
+        throw Exp("Invalid Content-Length " + len);
+    }
+    return num;
+}
+
+HttpClient::Response HttpClient::setupDownload(const std::string& hostName,
+    const std::string& path, boost::asio::ip::tcp::iostream& data,
+    const std::string& port, const HttpHeaders& reqHeaders) {
+    sendRequest("GET", hostName, path, data, port, reqHeaders);
+    data.flush();
+    return readResponse(data, "getting " + path + " from " + hostName +
+                        " at port " + port);
+}
+
+void HttpClient::sendRequest(const std::string& method,
+                             const std::string& hostName,
+                             const std::string& path,
+                             boost::asio::ip::tcp::iostream& data,
+                             const std::string& port,
+                             const HttpHeaders& reqHeaders) {
+    // Create a boost socket and request the log file from the server.
+    data.connect(hostName, port);
+
+    // check to make sure connection is good
+    if (!data.good()) {
+        throw Exp("Unable to connect to " + hostName + " at port " + port);
+    }
+
+    // send HTTP request to server
+    data << method << " " << path << " HTTP/1.1\r\n"
+         << "Host: " << hostName << "\r\n";
+    for (const auto& [name, value] : reqHeaders) {
+        data << name << ": " << value << "\r\n";
+    }
+    data << "Connection: Close\r\n\r\n";
+}
+
+HttpClient::Response HttpClient::readResponse(std::istream& data,
+                                              const std::string& what,
+                                              const bool notModifiedOk) {
+    // read the first line and make sure it has a 2xx (success) status
+    // or, if permitted, 304 (not modified)
+    Response resp;
+    std::string status;
+    getline(data, status);
+    if (std::sscanf(status.c_str(), "HTTP/%*s %d", &resp.status) != 1 ||
+        ((resp.status < 200 || resp.status > 299) &&
+         (resp.status != 304 || !notModifiedOk))) {
+        status = Helper::trim(status);
+        throw Exp("Error (" + status + ") " + what);
+    }
+
+    // read the rest of the header lines
+    for (std::string hdr; getline(data, hdr) && !hdr.empty() && hdr != "\r";) {
+        const size_t colon = hdr.find(':');
+        if (colon != std::string::npos) {
+            resp.headers[CSV::toLower(Helper::trim(hdr.substr(0, colon)))] =
+                Helper::trim(hdr.substr(colon + 1));
+        }
+    }
+    return resp;
+}
+
+std::string HttpClient::downloadRange(const std::string& host,
+                                      const std::string& port,
+                                      const std::string& path,
+                                      const long start, const long end,
+                                      const std::string& ifRange) {
+    HttpHeaders reqHeaders = {{"Range", "bytes=" + std::to_string(start) +
+                               "-" + std::to_string(end)}};
+    if (!ifRange.empty()) {
+        reqHeaders["If-Range"] = ifRange;
+    }
+    boost::asio::ip::tcp::iostream data;
+    const auto resp = setupDownload(host, path, data, port, reqHeaders);
+    long first, last, total;
+    if (resp.status != 206 ||
+        !parseContentRange(resp.header("content-range"), first, last, total) ||
+        first != start || last != end) {
+        throw Exp("Range " + std::to_string(start) + "-" +
+                  std::to_string(end) + " of " + path + " not returned by " +
+                  host);
+    }
+    std::string body = readBody(data, resp);
+    if (static_cast<long>(body.size()) != end - start + 1) {
+        throw Exp("Range " + std::to_string(start) + "-" +
+                  std::to_string(end) + " of " + path + " is truncated");
+    }
+    return body;
+}
+
+std::string HttpClient::readBody(std::istream& is, const Response& resp) {
+    HttpBody body(is, resp);
+    return std::string(std::istreambuf_iterator<char>(body),
+                       std::istreambuf_iterator<char>());
+}
+
+std::string HttpClient::validator(const Response& resp) {
+    // A strong ETag is preferred as modification times have a resolution
+    // of only a second.
+    for (const std::string name : {"etag", "last-modified"}) {
+        if (const std::string value = resp.header(name); !value.empty()) {
+            return name + ": " + value;
+        }
+    }
+    return "";
+}
+
+HttpHeaders HttpClient::conditionalHeaders(const std::string& validator) {
+    const size_t colon = validator.find(": ");
+    if (colon == std::string::npos) {
+        return {};
+    }
+    const std::string name = validator.substr(0, colon);
+    return {{(name == "etag" ? "If-None-Match" : "If-Modified-Since"),
+             validator.substr(colon + 2)}};
+}
+
+bool HttpClient::parseContentRange(const std::string& value, long& start,
+                                   long& end, long& total) {
+    return std::sscanf(value.c_str(), "bytes %ld-%ld/%ld", &start, &end,
+                       &total) == 3 && start <= end && end < total;
+}
@@ -0,0 +1,227 @@
+#ifndef HTTP_CLIENT_H
+#define HTTP_CLIENT_H
+
+/*
+ * A few helper methods to download data from a web-server. These methods
+ * are used to load CSV data from URLs of the form
+ * "http://localhost:8080/test.csv".
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include <boost/asio.hpp>
+#include <string>
+#include <unordered_map>
+
+/** The HTTP headers in a request or response. In responses, the names of
+ * the headers are converted to lower case to ease look-ups. */
+using HttpHeaders = std::unordered_map<std::string, std::string>;
+
+/**
+ * Static helper methods for the HTTP requests made by SQLAir. Similar to
+ * the Helper class, this class is never instantiated.
+ */
+class HttpClient {
+public:
+    /**
+     * The status line and headers of a response from a web-server.
+     */
+    struct Response {
+        /** The status code of the response, e.g., 200 */
+        int status = 0;
+
+        /** The headers in the response (with lower case names) */
+        HttpHeaders headers;
+
+        /**
+         * Obtain the value of a header in the response.
+         *
+         * @param name The name of the header in lower case.
+         *
+         * @return The value of the header or an empty string if the header
+         * was not in the response.
+         */
+        std::string header(const std::string& name) const;
+
+        /**
+         * Obtain the length of the body of the response.
+         *
+         * @return The value of the Content-Length header or -1 if the
+         * length was not specified.
+         */
+        long contentLength() const;
+    };
+
+    /**
+     * Helper method to setup a TCP stream for downloading data from an
+     * web-server. The basis for this method was taken from the
+     * LoginSentry.cpp file from HW3.
+     *
+     * @param host The host name of the web-server. Host names can be of
+     * the form "www.miamioh.edu" or "ceclnx01.cec.miamioh.edu".  This
+     * information is typically extracted from a given URL.
+     *
+     * @param path The path to the file being download.  An example of
+     * this value is "/~raodm/ssh_logs/full_logs.txt". This information is
+     * typically extracted from a given URL.
+     *
+     * @param socket The TCP stream (aka socket) to be setup by this
+     * method.  After a successful call to this method, this stream will
+     * contain the body of the response from the web-server to be processed.
+     *
+     * @param port An optional port number. The default port number is "80".
+     *
+     * @param reqHeaders Optional additional headers to be included in the
+     * request, e.g., {"Range", "bytes=0-1023"}.
+     *
+     * @return The status and headers of the response.
+     *
+     * @exception Exp This method throws an exception if the connection
+     * could not be established or if the status code was not 2xx or 304
+     * (not modified, in response to a conditional request).
+     */
+    static Response setupDownload(const std::string& host,
+                                  const std::string& path,
+                                  boost::asio::ip::tcp::iostream& socket,
+                                  const std::string& port = "80",
+                                  const HttpHeaders& reqHeaders = {});
+
+    /**
+     * Connect to a web-server and send the status line and headers of a
+     * request. The body of the request, if any, must be written to the
+     * stream by the caller.
+     *
+     * @param method The HTTP method, e.g., "GET" or "PUT".
+     *
+     * @param host The host name of the web-server.
+     *
+     * @param path The path to the file on the web-server.
+     *
+     * @param socket The TCP stream to be connected to the web-server.
+     *
+     * @param port The port number of the web-server.
+     *
+     * @param reqHeaders Additional headers to be included in the request.
+     *
+     * @exception Exp This method throws an exception if the connection
+     * could not be established.
+     */
+    static void sendRequest(const std::string& method,
+                            const std::string& host, const std::string& path,
+                            boost::asio::ip::tcp::iostream& socket,
+                            const std::string& port,
+                            const HttpHeaders& reqHeaders);
+
+    /**
+     * Read the status line and headers of a response from a web-server.
+     *
+     * @param socket The stream from where the response is to be read.
+     *
+     * @param what A description of the request used in error messages,
+     * e.g., "getting /test.csv from localhost at port 80".
+     *
+     * @param notModifiedOk If this flag is true, "304 Not Modified" is
+     * accepted (as a reply to a conditional GET). Uploads (PUT or POST)
+     * pass false so that only a 2xx status is treated as success.
+     *
+     * @return The status and headers of the response.
+     *
+     * @exception Exp This method throws an exception if the status code was
+     * not 2xx or (if notModifiedOk is true) 304.
+     */
+    static Response readResponse(std::istream& socket,
+                                 const std::string& what,
+                                 const bool notModifiedOk = true);
+
+    /**
+     * Download a range of bytes of a file from a web-server via a HTTP
+     * "Range" request.
+     *
+     * @param host The host name of the web-server.
+     *
+     * @param port The port number of the web-server.
+     *
+     * @param path The path to the file on the web-server.
+     *
+     * @param start The offset of the first byte to be downloaded.
+     *
+     * @param end The offset of the last byte (inclusive) to be downloaded.
+     *
+     * @param ifRange An optional ETag sent in an "If-Range" header so that
+     * the range is returned only if the file has not changed.
+     *
+     * @return The requested bytes.
+     *
+     * @exception Exp This method throws an exception if the server did
+     * not return exactly the requested range (e.g., the file changed).
+     */
+    static std::string downloadRange(const std::string& host,
+                                     const std::string& port,
+                                     const std::string& path,
+                                     const long start, const long end,
+                                     const std::string& ifRange = "");
+
+    /**
+     * Read the complete (decoded) body of a response (see HttpBody).
+     *
+     * @param is The stream from where the body is to be read.
+     *
+     * @param resp The status and headers of the response.
+     *
+     * @return The decoded body.
+     *
+     * @exception Exp This method throws an exception if the body could not
+     * be read or decoded.
+     */
+    static std::string readBody(std::istream& is, const Response& resp);
+
+    /**
+     * Obtain a string identifying the version of the file in a response.
+     * The string can be stored and later passed to conditionalHeaders().
+     *
+     * @param resp The response from the web-server.
+     *
+     * @return A string of the form "etag: <value>" or "last-modified:
+     * <value>" or an empty string if the response has neither header.
+     */
+    static std::string validator(const Response& resp);
+
+    /**
+     * Obtain the headers needed to make a request conditional, so that the
+     * server responds with "304 Not Modified" if the file has not changed.
+     *
+     * @param validator The string obtained from validator(). If it is an
+     * empty string, then no headers are returned.
+     *
+     * @return Either an If-None-Match or an If-Modified-Since header.
+     */
+    static HttpHeaders conditionalHeaders(const std::string& validator);
+
+    /**
+     * Parse the value of a "Content-Range" header of the form
+     * "bytes 0-1023/146515".
+     *
+     * @param value The value of the header.
+     *
+     * @param[out] start The offset of the first byte in the response.
+     *
+     * @param[out] end The offset of the last byte in the response.
+     *
+     * @param[out] total The size of the whole file.
+     *
+     * @return This method returns true if the value was parsed. It
+     * returns false if the value was invalid or the total size was not
+     * specified (i.e., it was "*").
+     */
+    static bool parseContentRange(const std::string& value, long& start,
+                                  long& end, long& total);
+
+private:
+    /**
+     * This class is never meant to be instantiated. Hence the constructor
+     * is intentionally private.
+     */
+    HttpClient();
+};
+
+#endif /* HTTP_CLIENT_H */
@@ -0,0 +1,143 @@
+/*
+ * Implementation of the chunked (and optionally compressed) upload stream.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include "HttpUpload.h"
+
+#include <cstdio>
+#include <string>
+#include "Helper.h"
+
+#ifdef SQLAIR_USE_ZLIB
+#include <zlib.h>
+
+/**
+ * A stream buffer that compresses the data written to it with gzip and
+ * writes the compressed data to another stream buffer.
+ */
+class DeflateBuf : public std::streambuf {
+public:
+    explicit DeflateBuf(std::streambuf& sink) : sink(sink),
+        in(HttpUpload::ChunkSize), out(HttpUpload::ChunkSize) {
+        // 15 + 16 = maximum window with a gzip header and trailer
+        if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+                         Z_DEFAULT_STRATEGY) != Z_OK) {
+            throw Exp("Unable to initialize zlib");
+        }
+        setp(in.data(), in.data() + in.size());
+    }
+
+    ~DeflateBuf() { deflateEnd(&zs); }
+
+    /** Compress the buffered data and write the gzip trailer */
+    void finish() { compress(Z_FINISH); }
+
+protected:
+    int_type overflow(int_type ch) override {
+        compress(Z_NO_FLUSH);
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+private:
+    /** Compress the data in the input buffer and write it to the sink */
+    void compress(const int flush) {
+        zs.next_in = reinterpret_cast<Bytef*>(pbase());
+        zs.avail_in = pptr() - pbase();
+        int rc;
+        do {
+            zs.next_out = reinterpret_cast<Bytef*>(out.data());
+            zs.avail_out = out.size();
+            rc = deflate(&zs, flush);
+            if (rc == Z_STREAM_ERROR) {
+                throw Exp("Error compressing data");
+            }
+            const auto len = out.size() - zs.avail_out;
+            if (sink.sputn(out.data(), len) != static_cast<long>(len)) {
+                throw Exp("Error writing compressed data");
+            }
+        } while (zs.avail_out == 0 || (flush == Z_FINISH &&
+                                       rc != Z_STREAM_END));
+        setp(in.data(), in.data() + in.size());
+    }
+
+    /** The stream buffer to where the compressed data is written */
+    std::streambuf& sink;
+
+    /** The zlib state */
+    z_stream zs = {};
+
+    /** The buffers for the data to be compressed and compressed data */
+    std::vector<char> in, out;
+};
+#endif
+
+HttpUpload::HttpUpload(std::ostream& socket, const bool compress) :
+    std::ostream(nullptr), chunked(socket) {
+    if (!compress) {
+        rdbuf(&chunked);
+    } else {
+#ifdef SQLAIR_USE_ZLIB
+        deflater = std::make_unique<DeflateBuf>(chunked);
+        rdbuf(deflater.get());
+#else
+        throw Exp("Compressing uploads requires compiling with "
+                  "-DSQLAIR_USE_ZLIB");
+#endif
+    }
+    // Report write errors as exceptions
+    exceptions(std::ios::badbit);
+}
+
+void HttpUpload::finish() {
+#ifdef SQLAIR_USE_ZLIB
+    if (deflater != nullptr) {
+        static_cast<DeflateBuf*>(deflater.get())->finish();
+    }
+#endif
+    chunked.sendChunk(true);
+}
+
+HttpUpload::ChunkedBuf::ChunkedBuf(std::ostream& socket) : socket(socket),
+    buffer(ChunkSize) {
+    setp(buffer.data(), buffer.data() + buffer.size());
+}
+
+void HttpUpload::ChunkedBuf::sendChunk(const bool last) {
+    // Each chunk is its size in hex, CRLF, the data, and CRLF
+    if (const size_t len = pptr() - pbase(); len > 0) {
+        char size[32];
+        snprintf(size, sizeof(size), "%zx\r\n", len);
+        socket << size;
+        socket.write(buffer.data(), len);
+        socket << "\r\n";
+    }
+    if (last) {
+        // An empty chunk marks the end of the body
+        socket << "0\r\n\r\n" << std::flush;
+    }
+    if (!socket.good()) {
+        throw Exp("Error sending data to the web-server");
+    }
+    setp(buffer.data(), buffer.data() + buffer.size());
+}
+
+HttpUpload::ChunkedBuf::int_type HttpUpload::ChunkedBuf::overflow(int_type ch) {
+    sendChunk();
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+int HttpUpload::ChunkedBuf::sync() {
+    // Data is sent when the buffer fills up (or in finish()) so that every
+    // chunk (except the last one) is a full buffer.
+    return 0;
+}
@@ -0,0 +1,89 @@
+#ifndef HTTP_UPLOAD_H
+#define HTTP_UPLOAD_H
+
+/*
+ * An output stream to send the body of a HTTP request using chunked
+ * transfer encoding. The data written to the stream is accumulated in a
+ * fixed-size buffer that is sent as a chunk whenever it fills up. Hence,
+ * large bodies (e.g., a CSV being saved) are streamed without ever being
+ * held in memory. If SQLAir is compiled with -DSQLAIR_USE_ZLIB (and linked
+ * with -lz), the body can optionally be compressed with gzip on the fly.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include <memory>
+#include <ostream>
+#include <streambuf>
+#include <vector>
+
+/**
+ * An output stream that writes a chunked (and optionally gzip compressed)
+ * HTTP request body to a socket. The caller must call finish() after
+ * writing all the data.
+ */
+class HttpUpload : public std::ostream {
+public:
+    /**
+     * Creates a stream to write a request body.
+     *
+     * @param socket The stream to where the chunks are written. The status
+     * line and headers of the request (including "Transfer-Encoding:
+     * chunked") must have already been written (see
+     * HttpClient::sendRequest).
+     *
+     * @param compress If this flag is true, the data is compressed with
+     * gzip. In this case, the request must include a "Content-Encoding:
+     * gzip" header.
+     *
+     * @exception Exp This method throws an exception if compression was
+     * requested but SQLAir was not compiled with -DSQLAIR_USE_ZLIB.
+     */
+    HttpUpload(std::ostream& socket, const bool compress = false);
+
+    /**
+     * Writes any buffered data and the final (empty) chunk that marks the
+     * end of the body, and flushes the socket.
+     *
+     * @exception Exp This method throws an exception if the data could not
+     * be written.
+     */
+    void finish();
+
+    /** The size of each chunk sent to the web-server */
+    static constexpr size_t ChunkSize = 64 * 1024;
+
+private:
+    /** The stream buffer that writes each full buffer as a chunk */
+    class ChunkedBuf : public std::streambuf {
+    public:
+        explicit ChunkedBuf(std::ostream& socket);
+
+        /**
+         * Send the buffered data (if any) as a chunk.
+         *
+         * @param last If this flag is true, the final (empty) chunk is also
+         * sent and the socket is flushed.
+         */
+        void sendChunk(const bool last = false);
+
+    protected:
+        int_type overflow(int_type ch) override;
+        int sync() override;
+
+    private:
+        /** The stream to where the chunks are written */
+        std::ostream& socket;
+
+        /** The buffer for the data in the next chunk */
+        std::vector<char> buffer;
+    };
+
+    /** The stream buffer that sends the chunks */
+    ChunkedBuf chunked;
+
+    /** The compressor, if the data is compressed */
+    std::unique_ptr<std::streambuf> deflater;
+};
+
+#endif /* HTTP_UPLOAD_H */
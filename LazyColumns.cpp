@@ -0,0 +1,137 @@
+/*
+ * Implementation of the lazy loading of the columns of a CSV file.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include "LazyColumns.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include "Helper.h"
+
+long LazyColumns::load(TableEntry& table, const std::string& path) {
+    CSV& csv = table.csv;
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat info;
+    if (fd == -1 || fstat(fd, &info) != 0) {
+        if (fd != -1) {
+            close(fd);
+        }
+        throw Exp("The supplied stream was not good.");
+    }
+    std::shared_ptr<LazyColumns> lazy(new LazyColumns());
+    lazy->size = info.st_size;
+    if (lazy->size > 0) {
+        void* addr = mmap(nullptr, lazy->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            close(fd);
+            throw Exp("Unable to map " + path + ": " + std::strerror(errno));
+        }
+        lazy->data = static_cast<char*>(addr);
+        madvise(addr, lazy->size, MADV_SEQUENTIAL);
+    }
+    close(fd);  // The mapping remains valid
+    // Use the standard loader to setup the column names
+    const char* const end = lazy->data + lazy->size;
+    const char* line = lazy->data;
+    const char* eol = (line == nullptr) ? nullptr :
+        static_cast<const char*>(std::memchr(line, '\n', lazy->size));
+    std::istringstream hdr(std::string(line, (eol ? eol : end) - line) +
+                           "\n");
+    csv.load(hdr);
+    // Index the rows, skipping blank lines just as the loader does
+    line = (eol == nullptr) ? end : eol + 1;
+    while (line < end) {
+        eol = static_cast<const char*>(std::memchr(line, '\n', end - line));
+        const char* next = (eol == nullptr) ? end : eol;
+        if (next > line && !(next - line == 1 && *line == '\r')) {
+            lazy->rowStarts.push_back(line - lazy->data);
+        }
+        line = (eol == nullptr) ? end : eol + 1;
+    }
+    csv.resize(lazy->rowStarts.size());
+    lazy->loaded.resize(csv.getColumnCount());
+    if (lazy->loaded.empty()) {
+        lazy->materialize(table, {});  // Nothing to materialize. Unmap file.
+    } else if (lazy->data != nullptr) {
+        madvise(lazy->data, lazy->size, MADV_DONTNEED);
+    }
+    table.lazy = lazy;
+    return lazy->size;
+}
+
+LazyColumns::~LazyColumns() {
+    if (data != nullptr) {
+        munmap(data, size);
+    }
+}
+
+bool LazyColumns::missing(const std::vector<int>& colIdxs) const {
+    for (const int colIdx : colIdxs) {
+        if (colIdx >= 0 && static_cast<size_t>(colIdx) < loaded.size() &&
+            !loaded[colIdx]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool LazyColumns::materialize(TableEntry& table,
+                              const std::vector<int>& colIdxs) {
+    std::vector<int> todo;
+    for (const int colIdx : colIdxs) {
+        if (missing({colIdx})) {
+            loaded[colIdx] = true;  // Also avoids duplicates in todo
+            todo.push_back(colIdx);
+        }
+    }
+    const size_t numCols = loaded.size();
+    numLoaded += todo.size();
+    // Rows only get cells up to the last materialized column. Once all the
+    // columns are materialized, rows get as many cells as in the file (as
+    // with the standard loader), including extra cells not in any column.
+    const bool allLoaded = (numLoaded == numCols);
+    for (const int colIdx : todo) {
+        width = std::max<size_t>(width, colIdx + 1);
+    }
+    std::string line;
+    for (size_t rowIdx = 0; !todo.empty() && (rowIdx < rowStarts.size());
+         rowIdx++) {
+        const char* start = data + rowStarts[rowIdx];
+        const char* eol = static_cast<const char*>(
+            std::memchr(start, '\n', data + size - start));
+        line.assign(start, (eol == nullptr ? data + size : eol) - start);
+        // Split the row just as the standard loader does
+        StrVec cells = CSV::tokenize(line, ",", false, "", "", false, false);
+        TableRow& row = table.writableRow(rowIdx);
+        const size_t rowWidth = allLoaded ? cells.size() :
+            std::min(width, cells.size());
+        row.resize(rowWidth);
+        for (const int colIdx : todo) {
+            if (static_cast<size_t>(colIdx) < cells.size()) {
+                row.set(colIdx, cells[colIdx]);
+            }
+        }
+        for (size_t i = numCols; allLoaded && (i < cells.size()); i++) {
+            row.set(i, cells[i]);
+        }
+    }
+    if (allLoaded && data != nullptr) {
+        // All the values are in memory. The file is no longer needed.
+        munmap(data, size);
+        data = nullptr;
+        rowStarts = std::vector<size_t>();
+    } else if (data != nullptr) {
+        // The pages are read again only when another column is used
+        madvise(data, size, MADV_DONTNEED);
+    }
+    return !todo.empty();
+}
@@ -0,0 +1,101 @@
+#ifndef LAZY_COLUMNS_H
+#define LAZY_COLUMNS_H
+
+/*
+ * Lazy loading of the columns of a local CSV file. The file is memory
+ * mapped and only the offset of each row is indexed when it is loaded.
+ * The values of a column are materialized (i.e., copied into the rows of
+ * the CSV) only when a query first references the column. Hence loading
+ * is fast and the memory used depends on the columns actually used.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "TableEntry.h"
+
+/**
+ * The memory mapped file and the row index of a lazily loaded table. Rows of
+ * the table only have cells up to the last column materialized so far (the
+ * cells of columns that have not been materialized are empty). Once all
+ * the columns are materialized, each row has all its cells.
+ */
+class LazyColumns {
+public:
+    /**
+     * Loads the column names of a local file and indexes its rows. The
+     * table's CSV gets one empty row for each row in the file (see
+     * TableEntry::adopt()).
+     *
+     * @param table The empty table to be loaded. Its lazy member is set to
+     * the object that tracks the columns yet to be materialized.
+     *
+     * @param path The path to the file to be loaded.
+     *
+     * @return The number of bytes of the file that were indexed.
+     *
+     * @exception Exp This method throws an exception if the file could not
+     * be opened or mapped.
+     */
+    static long load(TableEntry& table, const std::string& path);
+
+    /**
+     * Unmaps the file, if it is still mapped.
+     */
+    ~LazyColumns();
+
+    /**
+     * Determine if any of the given columns has not been materialized.
+     *
+     * @note The caller must hold the table's tableMutex (in shared mode).
+     *
+     * @param colIdxs The indexes of the columns. Negative values (e.g., no
+     * where clause) are ignored.
+     *
+     * @return This method returns true if materialize() must be called.
+     */
+    bool missing(const std::vector<int>& colIdxs) const;
+
+    /**
+     * Copy the values of columns from the file into the rows of the table.
+     * Once all the columns are materialized the file is unmapped.
+     *
+     * @note The caller must hold the table's tableMutex in exclusive mode.
+     *
+     * @param table The table whose columns are to be materialized.
+     *
+     * @param colIdxs The indexes of the columns. Columns that have already
+     * been materialized and negative values are ignored.
+     *
+     * @return This method returns true if any column was materialized.
+     */
+    bool materialize(TableEntry& table, const std::vector<int>& colIdxs);
+
+private:
+    /**
+     * The constructor is private. Instances are created via load().
+     */
+    LazyColumns() = default;
+
+    /** The memory mapped file or nullptr once all columns are loaded */
+    char* data = nullptr;
+
+    /** The size of the memory mapped file */
+    size_t size = 0;
+
+    /** The offset in the file of each row of the CSV */
+    std::vector<size_t> rowStarts;
+
+    /** Flag for each column to indicate if it has been materialized */
+    std::vector<bool> loaded;
+
+    /** The number of columns that have been materialized */
+    size_t numLoaded = 0;
+
+    /** The number of cells in the rows until all columns are loaded */
+    size_t width = 0;
+};
+
+#endif /* LAZY_COLUMNS_H */
@@ -0,0 +1,83 @@
+/*
+ * Implementation of the locale-independent number helpers and the numeric
+ * shadow of CSV columns.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include "Numeric.h"
+
+#include <charconv>
+#include <cmath>
+#include <limits>
+
+#include "TableEntry.h"
+
+bool Numeric::parse(std::string_view str, double& val) {
+    if (!str.empty() && str.front() == '+') {
+        str.remove_prefix(1);
+    }
+    double num;
+    const auto end = str.data() + str.size();
+    const auto [ptr, ec] = std::from_chars(str.data(), end, num);
+    if (ec != std::errc() || ptr != end || !std::isfinite(num)) {
+        return false;
+    }
+    val = num;
+    return true;
+}
+
+std::string_view Numeric::format(double val, char* buf) {
+    const auto [ptr, ec] = std::to_chars(buf, buf + MaxChars, val);
+    return std::string_view(buf, ptr - buf);
+}
+
+std::string_view Numeric::format(long long val, char* buf) {
+    const auto [ptr, ec] = std::to_chars(buf, buf + MaxChars, val);
+    return std::string_view(buf, ptr - buf);
+}
+
+bool Numeric::isNumericCond(const std::string& cond) {
+    return cond == "=" || cond == "<>";
+}
+
+double NumericShadow::toShadow(std::string_view cell) {
+    double val = std::numeric_limits<double>::quiet_NaN();
+    Numeric::parse(cell, val);
+    return val;
+}
+
+const std::vector<double>* NumericShadow::column(TableEntry& table,
+                                                 const int col) {
+    std::scoped_lock<std::mutex> lock(mutex);
+    const auto entry = columns.find(col);
+    if (entry != columns.end()) {
+        return &entry->second;
+    }
+    // Values cannot be reliably cached while an update is in progress.
+    const long started = writesStarted;
+    if (started != writesFinished) {
+        return nullptr;
+    }
+    std::vector<double> values(table.size());
+    for (size_t i = 0; (i < table.size()); i++) {
+        auto& row = table.row(i);
+        std::scoped_lock<std::mutex> rowLock(row.rowMutex);
+        values[i] = toShadow(row.at(col));
+    }
+    if (started != writesStarted) {
+        return nullptr;  // An update started while we were parsing values
+    }
+    return &(columns[col] = std::move(values));
+}
+
+std::vector<double>* NumericShadow::find(const int col) {
+    std::scoped_lock<std::mutex> lock(mutex);
+    const auto entry = columns.find(col);
+    return (entry != columns.end() ? &entry->second : nullptr);
+}
+
+void NumericShadow::clear() {
+    std::scoped_lock<std::mutex> lock(mutex);
+    columns.clear();
+}
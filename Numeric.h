@@ -0,0 +1,187 @@
+#ifndef NUMERIC_H
+#define NUMERIC_H
+
+/*
+ * Locale-independent helpers to quickly parse and format numbers using
+ * std::from_chars and std::to_chars, along with a cache of the numeric
+ * values of columns (the "numeric shadow") so that numeric comparisons do
+ * not have to repeatedly parse the strings stored in a CSV.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Forward declaration to avoid circular include with TableEntry.h
+class TableEntry;
+
+/**
+ * This class has static helper methods to parse and format numbers.
+ * Similar to the Helper class, this class is never instantiated.
+ */
+class Numeric {
+public:
+    /**
+     * Parses a string as a (finite) floating point number. The entire
+     * string must be a number for this method to succeed. An optional
+     * leading '+' is permitted.
+     *
+     * @param str The string to be parsed, e.g., "-6.081689835"
+     *
+     * @param[out] val The parsed value. This value is unchanged if the
+     * string is not a valid number.
+     *
+     * @return This method returns true if the string was a valid number.
+     */
+    static bool parse(std::string_view str, double& val);
+
+    /**
+     * Formats a floating point number using the shortest representation
+     * that round-trips exactly, e.g., -6.081689835 is formatted as
+     * "-6.081689835".
+     *
+     * @param val The value to be formatted.
+     *
+     * @param buf The buffer into which the value is to be formatted. This
+     * buffer must be at least MaxChars long.
+     *
+     * @return A view into buf with the formatted value.
+     */
+    static std::string_view format(double val, char* buf);
+
+    /**
+     * Formats an integer into a given buffer.
+     *
+     * @param val The value to be formatted.
+     *
+     * @param buf The buffer into which the value is to be formatted. This
+     * buffer must be at least MaxChars long.
+     *
+     * @return A view into buf with the formatted value.
+     */
+    static std::string_view format(long long val, char* buf);
+
+    /**
+     * Checks if a condition in a where clause can use the numeric shadow.
+     * Both "=" and "<>" compare the text exactly, but numbers that differ
+     * must have different text. So the shadow quickly detects most rows
+     * whose values differ from a number.
+     *
+     * @param cond The condition. Only "=" and "<>" are numeric conditions.
+     *
+     * @return This method returns true if cond is a numeric condition.
+     */
+    static bool isNumericCond(const std::string& cond);
+
+    /** The maximum number of characters produced by the format methods */
+    static constexpr size_t MaxChars = 32;
+
+private:
+    /**
+     * This class is never meant to be instantiated. Hence the constructor
+     * is intentionally private.
+     */
+    Numeric();
+};
+
+/**
+ * A cache of the numeric values of the columns in a table. The numeric values
+ * of a column are parsed once, the first time a query compares the column
+ * with a number. Cells that are not numbers are stored as NaN.
+ *
+ * Each entry for a row is read and written only while holding that row's
+ * rowMutex (just like the strings in the row). Queries that update rows
+ * must make their changes within a WriteScope so that a column is never
+ * cached while its values are being changed.
+ */
+class NumericShadow {
+public:
+    /**
+     * An RAII class that marks an update as in progress until this object
+     * goes out of scope, even if the update throws an exception.
+     */
+    class WriteScope {
+    public:
+        /**
+         * Marks the start of an update of the rows.
+         *
+         * @param shadow The cache of the table whose rows are updated.
+         */
+        explicit WriteScope(NumericShadow& shadow) : shadow(shadow) {
+            shadow.beginWrite();
+        }
+
+        /** Marks the end of the update */
+        ~WriteScope() { shadow.endWrite(); }
+
+        /** Each scope must end exactly once and hence cannot be copied */
+        WriteScope(const WriteScope&) = delete;
+        WriteScope& operator=(const WriteScope&) = delete;
+
+    private:
+        /** The cache of the table being updated */
+        NumericShadow& shadow;
+    };
+
+    /**
+     * Obtain the numeric values for a given column, parsing the values from
+     * the table if needed.
+     *
+     * @param table The table whose column is to be returned.
+     *
+     * @param col The zero-based index of the column.
+     *
+     * @return The cached values for the column. This method returns nullptr
+     * if the column could not be cached because rows are being updated.
+     */
+    const std::vector<double>* column(TableEntry& table, const int col);
+
+    /**
+     * Obtain the numeric values for a column, only if it is cached. This
+     * method is used by updates to keep the cache consistent.
+     *
+     * @param col The zero-based index of the column.
+     *
+     * @return The cached values for the column or nullptr if the column is
+     * not cached.
+     */
+    std::vector<double>* find(const int col);
+
+    /** Discards all cached columns, e.g., when rows are added or removed. */
+    void clear();
+
+    /**
+     * Convenience method to parse a cell into the value stored in the cache.
+     *
+     * @param cell The value in a cell of the CSV.
+     *
+     * @return The numeric value or NaN if the cell is not a number.
+     */
+    static double toShadow(std::string_view cell);
+
+private:
+    /** Called at the start of a query that may change values in rows. */
+    void beginWrite() { writesStarted++; }
+
+    /** Called at the end of a query that may change values in rows. */
+    void endWrite() { writesFinished++; }
+
+    /** The cached columns. The key is the zero-based column index. */
+    std::unordered_map<int, std::vector<double>> columns;
+
+    /** The mutex to enable MT-safe access to the columns map */
+    std::mutex mutex;
+
+    /** The number of updates that have started */
+    std::atomic<long> writesStarted = {0};
+
+    /** The number of updates that have finished */
+    std::atomic<long> writesFinished = {0};
+};
+
+#endif /* NUMERIC_H */
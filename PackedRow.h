@@ -0,0 +1,214 @@
+#ifndef PACKED_ROW_H
+#define PACKED_ROW_H
+
+/*
+ * A compact representation of a row of strings. All the cells of the row
+ * are stored in one contiguous buffer, preceded by a small array of
+ * offsets. Hence a row needs at most one heap allocation (instead of one
+ * per cell for a vector-of-strings) and scanning the cells of a row
+ * touches contiguous memory.
+ *
+ * The rows of tables are packed (see TableRow) when the loaders' rows
+ * (CSVRow objects filled by CSV::load) are moved into the table's
+ * segments. Queries also use packed rows for their transient copies of
+ * rows, e.g., the selected cells of a row.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <memory_resource>
+#include <mutex>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * A row of cells packed into a single buffer. The layout of the buffer is:
+ *
+ *     [offset 0][offset 1]...[offset n][cell 0 chars][cell 1 chars]...
+ *
+ * where offset i is the position (relative to the start of the characters)
+ * where cell i starts and offset n is the total number of characters.
+ * Assigning or updating values reuses the buffer if the new data fits in
+ * it. Otherwise the buffer is reallocated once.
+ */
+class PackedRow {
+public:
+    /**
+     * Creates an empty row whose buffer is allocated from a given memory
+     * resource.
+     *
+     * @param res The memory resource to be used, e.g., a query's arena.
+     * Copies of a row always use the default resource.
+     */
+    explicit PackedRow(std::pmr::memory_resource* res =
+                       std::pmr::get_default_resource()) : buf(res) {}
+
+    /**
+     * Replaces the contents of this row with the given cells.
+     *
+     * @param begin Iterator to the first cell. Cells must be convertible
+     * to std::string_view and must not refer to this row.
+     *
+     * @param end Iterator past the last cell.
+     */
+    template<typename Iter>
+    void assign(Iter begin, Iter end) {
+        numCells = end - begin;
+        size_t numChars = 0;
+        for (auto cell = begin; cell != end; cell++) {
+            numChars += std::string_view(*cell).size();
+        }
+        buf.resize(charsStart() + numChars);  // Reuses existing capacity
+        uint32_t pos = 0;
+        for (size_t i = 0; i < numCells; i++, begin++) {
+            const std::string_view cell(*begin);
+            setOffset(i, pos);
+            std::memcpy(chars() + pos, cell.data(), cell.size());
+            pos += cell.size();
+        }
+        setOffset(numCells, pos);
+    }
+
+    /**
+     * Replaces the value of a cell, shifting the cells after it. If the
+     * row has fewer cells, empty cells are added first (see resize()).
+     *
+     * @param idx The zero-based index of the cell to be changed.
+     *
+     * @param val The new value for the cell. It must not refer to this row.
+     */
+    void set(const size_t idx, std::string_view val) {
+        resize(idx + 1);
+        const uint32_t start = offset(idx), end = offset(idx + 1);
+        const long diff = long(val.size()) - long(end - start);
+        const size_t tail = offset(numCells) - end;
+        if (diff > 0) {
+            buf.resize(buf.size() + diff);  // May reallocate the buffer
+        }
+        char* const data = chars();
+        std::memmove(data + end + diff, data + end, tail);
+        std::memcpy(data + start, val.data(), val.size());
+        if (diff < 0) {
+            buf.resize(buf.size() + diff);  // Keeps the capacity
+        }
+        for (size_t i = idx + 1; i <= numCells; i++) {
+            setOffset(i, offset(i) + diff);
+        }
+    }
+
+    /**
+     * Adds empty cells at the end of this row. Rows are never shrunk.
+     *
+     * @param count The number of cells the row should have at least.
+     */
+    void resize(const size_t count) {
+        if (buf.empty()) {
+            buf.resize(sizeof(uint32_t));  // The end offset of no cells
+            setOffset(0, 0);
+        }
+        if (count <= numCells) {
+            return;
+        }
+        const uint32_t numChars = offset(numCells);
+        const size_t oldStart = charsStart();
+        buf.resize(buf.size() + (count - numCells) * sizeof(uint32_t));
+        std::memmove(buf.data() + (count + 1) * sizeof(uint32_t),
+                     buf.data() + oldStart, numChars);
+        for (size_t i = numCells + 1; i <= count; i++) {
+            setOffset(i, numChars);
+        }
+        numCells = count;
+    }
+
+    /**
+     * Obtain the value of a cell.
+     *
+     * @param idx The zero-based index of the cell.
+     *
+     * @return A view of the cell's value. The view is invalidated when
+     * this row is changed.
+     */
+    std::string_view operator[](const size_t idx) const {
+        const uint32_t start = offset(idx);
+        return std::string_view(chars() + start, offset(idx + 1) - start);
+    }
+
+    /**
+     * Obtain the value of a cell, checking the index.
+     *
+     * @param idx The zero-based index of the cell.
+     *
+     * @return A view of the cell's value.
+     *
+     * @exception std::out_of_range If the index is invalid.
+     */
+    std::string_view at(const size_t idx) const {
+        if (idx >= numCells) {
+            throw std::out_of_range("PackedRow index out of range");
+        }
+        return (*this)[idx];
+    }
+
+    /** Obtain the number of cells in this row. */
+    size_t size() const { return numCells; }
+
+    /** Obtain the number of bytes allocated for this row's buffer. */
+    size_t capacity() const { return buf.capacity(); }
+
+private:
+    /** The position in buf where the characters of the cells start */
+    size_t charsStart() const { return (numCells + 1) * sizeof(uint32_t); }
+
+    /** Pointer to the first character of the first cell */
+    char* chars() { return buf.data() + charsStart(); }
+    const char* chars() const { return buf.data() + charsStart(); }
+
+    /** Read the offset of a cell. memcpy avoids unaligned accesses. */
+    uint32_t offset(const size_t idx) const {
+        uint32_t off;
+        std::memcpy(&off, buf.data() + idx * sizeof(uint32_t), sizeof(off));
+        return off;
+    }
+
+    /** Write the offset of a cell */
+    void setOffset(const size_t idx, const uint32_t off) {
+        std::memcpy(buf.data() + idx * sizeof(uint32_t), &off, sizeof(off));
+    }
+
+    /** The single buffer with the offsets followed by the characters */
+    std::pmr::vector<char> buf;
+
+    /** The number of cells in this row */
+    size_t numCells = 0;
+};
+
+/**
+ * A row of a table (see TableEntry). Similar to CSVRow, each row has a
+ * mutex that guards its cells. Copies of a row have their own mutex.
+ */
+class TableRow : public PackedRow {
+public:
+    /** Creates an empty row */
+    TableRow() {}
+
+    /** Copies the cells of another row */
+    TableRow(const TableRow& src) : PackedRow(src) {}
+
+    /** Takes over the cells of another row */
+    TableRow(TableRow&& src) noexcept : PackedRow(std::move(src)) {}
+
+    /** Copies the cells of another row */
+    TableRow& operator=(const TableRow& src) {
+        PackedRow::operator=(src);
+        return *this;
+    }
+
+    /** The mutex to be held while reading or changing the cells */
+    std::mutex rowMutex;
+};
+
+#endif /* PACKED_ROW_H */
@@ -0,0 +1,82 @@
+/*
+ * Implementation of the read-ahead input stream.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include "PipelinedInput.h"
+
+#include "AllocTracker.h"
+
+PipelinedInput::PipelinedInput(std::istream& source, const size_t blockSize,
+                               const size_t maxBlocks) :
+    std::istream(nullptr), buf(source, blockSize, maxBlocks) {
+    rdbuf(&buf);
+    // The data read ahead is counted as allocated by the calling query
+    buf.reader = std::thread(AllocTracker::wrap([this] { buf.read(); }));
+}
+
+PipelinedInput::~PipelinedInput() {
+    buf.stop();
+}
+
+void PipelinedInput::finish() {
+    buf.stop();
+    if (buf.error) {
+        std::rethrow_exception(buf.error);
+    }
+}
+
+PipelinedInput::PipeBuf::PipeBuf(std::istream& source, size_t blockSize,
+                                 size_t maxBlocks) :
+    source(source), blockSize(blockSize), maxBlocks(maxBlocks) {
+}
+
+void PipelinedInput::PipeBuf::read() {
+    try {
+        while (true) {
+            std::string block(blockSize, '\0');
+            // Reads until the block is full or the source ends
+            block.resize(source.rdbuf()->sgetn(block.data(), blockSize));
+            std::unique_lock<std::mutex> lock(mutex);
+            queueChanged.wait(lock, [this] {
+                return stopping || queue.size() < maxBlocks; });
+            if (stopping || block.empty()) {
+                break;
+            }
+            queue.push_back(std::move(block));
+            queueChanged.notify_all();
+        }
+    } catch (...) {
+        std::scoped_lock<std::mutex> lock(mutex);
+        error = std::current_exception();
+    }
+    std::scoped_lock<std::mutex> lock(mutex);
+    done = true;
+    queueChanged.notify_all();
+}
+
+void PipelinedInput::PipeBuf::stop() {
+    if (reader.joinable()) {
+        {
+            // Unblocks the reader if it is waiting for space in the queue
+            std::scoped_lock<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        queueChanged.notify_all();
+        reader.join();
+    }
+}
+
+PipelinedInput::PipeBuf::int_type PipelinedInput::PipeBuf::underflow() {
+    std::unique_lock<std::mutex> lock(mutex);
+    queueChanged.wait(lock, [this] { return done || !queue.empty(); });
+    if (queue.empty()) {
+        return traits_type::eof();
+    }
+    current = std::move(queue.front());
+    queue.pop_front();
+    queueChanged.notify_all();  // The reader can queue another block
+    setg(current.data(), current.data(), current.data() + current.size());
+    return traits_type::to_int_type(current[0]);
+}
@@ -0,0 +1,119 @@
+#ifndef PIPELINED_INPUT_H
+#define PIPELINED_INPUT_H
+
+/*
+ * An input stream that reads its data from another (typically a network)
+ * stream on a background thread. The reader thread fills large blocks and
+ * queues them while the consumer (e.g., CSV::load) parses the blocks read
+ * earlier. This overlaps network I/O with parsing.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <istream>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <thread>
+
+/**
+ * An input stream whose data is read ahead from a source stream by a
+ * background thread. At most a fixed number of blocks are queued so that
+ * memory usage remains bounded if the consumer is slower than the source.
+ */
+class PipelinedInput : public std::istream {
+public:
+    /**
+     * Creates the stream and starts the background thread that reads from
+     * the source stream.
+     *
+     * @param source The stream from where the data is read. The source
+     * must not be used by the caller until finish() is called or this
+     * object is destroyed.
+     *
+     * @param blockSize The size of each block read from the source.
+     *
+     * @param maxBlocks The maximum number of blocks queued at any time.
+     */
+    explicit PipelinedInput(std::istream& source,
+                            const size_t blockSize = BlockSize,
+                            const size_t maxBlocks = MaxBlocks);
+
+    /**
+     * Stops reading from the source and waits for the background thread
+     * to finish.
+     */
+    ~PipelinedInput();
+
+    /**
+     * Wait for the background thread to finish. This method must be called
+     * after the data has been consumed to check for read errors.
+     *
+     * @exception This method rethrows any exception that occurred when
+     * reading from the source.
+     */
+    void finish();
+
+    /** The default size of each block read from the source */
+    static constexpr size_t BlockSize = 256 * 1024;
+
+    /** The default number of blocks that may be queued */
+    static constexpr size_t MaxBlocks = 8;
+
+private:
+    /** The stream buffer that hands out blocks queued by the reader */
+    class PipeBuf : public std::streambuf {
+    public:
+        PipeBuf(std::istream& source, size_t blockSize, size_t maxBlocks);
+
+        /** The method run by the background thread to read blocks */
+        void read();
+
+        /** Ask the reader to stop and wait for it to finish */
+        void stop();
+
+        /** The source stream */
+        std::istream& source;
+
+        /** The size of each block */
+        const size_t blockSize;
+
+        /** The maximum number of blocks in queue */
+        const size_t maxBlocks;
+
+        /** The blocks read but not yet consumed */
+        std::deque<std::string> queue;
+
+        /** The block currently being consumed */
+        std::string current;
+
+        /** Flag set by the reader once the source has no more data */
+        bool done = false;
+
+        /** Flag set by the consumer to stop the reader early */
+        bool stopping = false;
+
+        /** Any exception that occurred when reading the source */
+        std::exception_ptr error;
+
+        /** Mutex to protect the queue and the flags */
+        std::mutex mutex;
+
+        /** Condition variable signaled when a block is queued or consumed */
+        std::condition_variable queueChanged;
+
+        /** The background thread that reads from the source */
+        std::thread reader;
+
+    protected:
+        int_type underflow() override;
+    };
+
+    /** The buffer from where this stream reads its data */
+    PipeBuf buf;
+};
+
+#endif /* PIPELINED_INPUT_H */
@@ -0,0 +1,52 @@
+/*
+ * Implementation of the per-request arena and its pool of buffers.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include "QueryArena.h"
+
+#include <mutex>
+
+/** The arena active on the calling thread, if any */
+static thread_local std::pmr::memory_resource* currentArena = nullptr;
+
+/** Buffers returned by finished requests, ready for reuse */
+static std::vector<std::unique_ptr<std::byte[]>> bufferPool;
+
+/** The mutex to enable MT-safe access to bufferPool */
+static std::mutex bufferPoolMutex;
+
+QueryArena::QueryArena(const bool fresh) : outer(currentArena) {
+    if (currentArena != nullptr && !fresh) {
+        return;  // Use the outer arena that is already active
+    }
+    {   // Reuse a buffer from the pool if one is available
+        std::scoped_lock<std::mutex> lock(bufferPoolMutex);
+        if (!bufferPool.empty()) {
+            buffer = std::move(bufferPool.back());
+            bufferPool.pop_back();
+        }
+    }
+    if (!buffer) {
+        buffer = std::make_unique<std::byte[]>(BufferSize);
+    }
+    arena = std::make_unique<std::pmr::monotonic_buffer_resource>(
+        buffer.get(), BufferSize);
+    currentArena = arena.get();
+}
+
+QueryArena::~QueryArena() {
+    if (!arena) {
+        return;  // This was a nested scope that did not create an arena
+    }
+    currentArena = outer;
+    arena.reset();  // Release any overflow memory obtained from upstream
+    std::scoped_lock<std::mutex> lock(bufferPoolMutex);
+    bufferPool.push_back(std::move(buffer));
+}
+
+std::pmr::memory_resource* QueryArena::resource() {
+    return (currentArena != nullptr ? currentArena
+                                    : std::pmr::get_default_resource());
+}
@@ -0,0 +1,123 @@
+#ifndef QUERY_ARENA_H
+#define QUERY_ARENA_H
+
+/*
+ * A per-request arena to streamline allocation of the many short-lived
+ * strings and vectors created when processing a query. Each request uses a
+ * std::pmr::monotonic_buffer_resource backed by a reusable buffer. All the
+ * memory is released in one shot when the request finishes and the buffer
+ * is returned to a pool so that the next request can reuse it.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include <memory_resource>
+#include <memory>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+/**
+ * An RAII class that sets up an arena for the current thread. The arena
+ * remains active until this object goes out of scope. Nested arenas are
+ * not created -- if the calling thread already has an active arena, then
+ * the constructor and destructor of this class do nothing. This enables
+ * creating an arena at the top of a request and again in process() without
+ * worrying about which one runs first.
+ */
+class QueryArena {
+public:
+    /**
+     * Sets up an arena for the calling thread using a pooled buffer, unless
+     * the thread already has an active arena.
+     *
+     * @param fresh If this flag is true, a new arena is set up even if the
+     * thread already has an active arena. The outer arena becomes active
+     * again when this object goes out of scope. This is used to release
+     * the memory of each attempt of a query that is rerun (e.g., "wait
+     * select"), while the outer arena holds the response.
+     */
+    explicit QueryArena(const bool fresh = false);
+
+    /**
+     * Releases all memory allocated from the arena and returns the buffer
+     * to the pool for reuse by subsequent requests.
+     */
+    ~QueryArena();
+
+    /** The arena is tied to a thread and hence cannot be copied */
+    QueryArena(const QueryArena&) = delete;
+    QueryArena& operator=(const QueryArena&) = delete;
+
+    /**
+     * Obtain the memory resource to be used for allocations associated with
+     * the current request.
+     *
+     * @return The active arena for the calling thread. If an arena is not
+     * active, then this method returns the default memory resource.
+     */
+    static std::pmr::memory_resource* resource();
+
+    /** The size of each reusable buffer in bytes */
+    static constexpr size_t BufferSize = 64 * 1024;
+
+private:
+    /** The buffer (from the pool) used by this arena, if any */
+    std::unique_ptr<std::byte[]> buffer;
+
+    /** The monotonic resource that carves allocations out of buffer */
+    std::unique_ptr<std::pmr::monotonic_buffer_resource> arena;
+
+    /** The arena that was active when this arena was set up, if any */
+    std::pmr::memory_resource* outer = nullptr;
+};
+
+/**
+ * A simple output stream that accumulates its output in a std::pmr::string
+ * allocated from the current request's arena. This is used instead of a
+ * std::ostringstream to buffer a response before it is sent to a client.
+ */
+class ArenaStream : public std::ostream {
+public:
+    /**
+     * Creates an empty stream whose buffer is allocated from the calling
+     * thread's arena (see QueryArena::resource()).
+     */
+    ArenaStream() : std::ostream(nullptr), buf(QueryArena::resource()) {
+        rdbuf(&buf);
+    }
+
+    /**
+     * Obtain the data written to this stream so far.
+     *
+     * @return A reference to the data accumulated in this stream.
+     */
+    const std::pmr::string& str() const { return buf.data; }
+
+private:
+    /** The stream buffer that appends all data to a pmr::string */
+    class StringBuf : public std::streambuf {
+    public:
+        explicit StringBuf(std::pmr::memory_resource* res) : data(res) {}
+        std::pmr::string data;
+
+    protected:
+        int_type overflow(int_type ch) override {
+            if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+                data.push_back(traits_type::to_char_type(ch));
+            }
+            return traits_type::not_eof(ch);
+        }
+
+        std::streamsize xsputn(const char* s, std::streamsize n) override {
+            data.append(s, n);
+            return n;
+        }
+    };
+
+    /** The buffer where all the data is accumulated */
+    StringBuf buf;
+};
+
+#endif /* QUERY_ARENA_H */
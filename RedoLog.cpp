@@ -0,0 +1,185 @@
+/*
+ * Implementation of the redo log of changes made by update queries.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include "RedoLog.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include "Helper.h"
+#include "TableSnapshot.h"
+
+namespace {
+
+/**
+ * Find the files of the generations of a log.
+ *
+ * @param basePath The path prefix of the files of the log.
+ *
+ * @return The path to the file of each generation, ordered by generation.
+ */
+std::map<long, std::string> generationFiles(const std::string& basePath) {
+    namespace fs = std::filesystem;
+    std::map<long, std::string> files;
+    const fs::path base(basePath);
+    const std::string prefix = base.filename().string() + ".redo.";
+    const fs::path dir = base.has_parent_path() ? base.parent_path() : ".";
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(dir, ec)) {
+        const std::string name = entry.path().filename().string();
+        if (name.compare(0, prefix.size(), prefix) == 0 &&
+            name.size() > prefix.size() &&
+            name.find_first_not_of("0123456789", prefix.size()) ==
+            std::string::npos) {
+            files[std::stol(name.substr(prefix.size()))] =
+                entry.path().string();
+        }
+    }
+    return files;
+}
+
+}  // namespace
+
+RedoLog::RedoLog(const std::string& basePath, const long generation) :
+    basePath(basePath), generation(generation) {
+}
+
+RedoLog::~RedoLog() {
+    closeFile();
+}
+
+void RedoLog::addChange(std::string& record, const size_t rowIdx,
+                        const int colIdx, const std::string& value) {
+    const uint64_t row = rowIdx;
+    const uint32_t col = colIdx, len = value.size();
+    record.append(reinterpret_cast<const char*>(&row), sizeof(row));
+    record.append(reinterpret_cast<const char*>(&col), sizeof(col));
+    record.append(reinterpret_cast<const char*>(&len), sizeof(len));
+    record.append(value);
+}
+
+void RedoLog::append(const std::string& record) {
+    std::scoped_lock<std::mutex> lock(mutex);
+    if (fd == -1) {
+        const std::string path = basePath + ".redo." +
+            std::to_string(generation);
+        std::error_code ec;
+        std::filesystem::create_directories(
+            std::filesystem::path(path).parent_path(), ec);
+        fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+                  0644);
+        if (fd == -1) {
+            throw Exp("Unable to open redo log " + path + ": " +
+                      std::strerror(errno));
+        }
+        // The new file must be found by replay() after a crash
+        const std::filesystem::path dir =
+            std::filesystem::path(path).parent_path();
+        TableSnapshot::sync(dir.empty() ? "." : dir.string());
+    }
+    // Records are never interleaved as appends hold the mutex
+    for (size_t done = 0; done < record.size();) {
+        const ssize_t n = write(fd, record.data() + done,
+                                record.size() - done);
+        if (n < 0 && errno != EINTR) {
+            throw Exp("Error writing redo log: " +
+                      std::string(std::strerror(errno)));
+        }
+        done += std::max<ssize_t>(n, 0);
+    }
+    // The update is reported only once its changes are on disk
+    if (fdatasync(fd) == -1) {
+        throw Exp("Error flushing redo log: " +
+                  std::string(std::strerror(errno)));
+    }
+    hasChanges = true;
+}
+
+bool RedoLog::empty() {
+    std::scoped_lock<std::mutex> lock(mutex);
+    return !hasChanges;
+}
+
+long RedoLog::rotate() {
+    std::scoped_lock<std::mutex> lock(mutex);
+    closeFile();
+    hasChanges = false;
+    return ++generation;
+}
+
+void RedoLog::removeBefore(const long generation) {
+    for (const auto& [gen, path] : generationFiles(basePath)) {
+        if (gen < generation) {
+            std::error_code ec;
+            std::filesystem::remove(path, ec);
+        }
+    }
+}
+
+void RedoLog::discard() {
+    std::scoped_lock<std::mutex> lock(mutex);
+    closeFile();
+    hasChanges = false;
+    for (const auto& [gen, path] : generationFiles(basePath)) {
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+    }
+}
+
+long RedoLog::replay(TableEntry& table, const std::string& basePath,
+                     const long generation) {
+    long numChanges = 0;
+    for (const auto& [gen, path] : generationFiles(basePath)) {
+        if (gen < generation) {
+            continue;
+        }
+        std::ifstream in(path, std::ios::binary);
+        const std::string data((std::istreambuf_iterator<char>(in)),
+                               std::istreambuf_iterator<char>());
+        const size_t HeaderSize = sizeof(uint64_t) + 2 * sizeof(uint32_t);
+        for (size_t pos = 0; pos + HeaderSize <= data.size();) {
+            uint64_t row;
+            uint32_t col, len;
+            std::memcpy(&row, data.data() + pos, sizeof(row));
+            std::memcpy(&col, data.data() + pos + sizeof(row), sizeof(col));
+            std::memcpy(&len, data.data() + pos + sizeof(row) + sizeof(col),
+                        sizeof(len));
+            pos += HeaderSize;
+            if (pos + len > data.size()) {
+                break;  // Record torn by a crash
+            }
+            // Rows appended to the file after the checkpoint are not in
+            // the table. Such changes cannot be applied.
+            if (row < table.size() && col < table.row(row).size()) {
+                table.writableRow(row).set(col,
+                    std::string_view(data).substr(pos, len));
+                numChanges++;
+            }
+            pos += len;
+        }
+    }
+    return numChanges;
+}
+
+long RedoLog::nextGeneration(const std::string& basePath) {
+    const auto files = generationFiles(basePath);
+    return files.empty() ? 0 : files.rbegin()->first + 1;
+}
+
+void RedoLog::closeFile() {
+    if (fd != -1) {
+        close(fd);
+        fd = -1;
+    }
+}
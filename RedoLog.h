@@ -0,0 +1,141 @@
+#ifndef REDO_LOG_H
+#define REDO_LOG_H
+
+/*
+ * A compact redo log of the changes made to a CSV by update queries. The
+ * log, together with periodic checkpoints (snapshots of the CSV, see
+ * TableSnapshot), is used to recover unsaved changes after a crash. The
+ * log is split into numbered generations: each checkpoint starts a new
+ * generation so that older generations can be deleted and recovery only
+ * replays the changes made after the latest checkpoint.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include <mutex>
+#include <string>
+#include "TableEntry.h"
+
+/**
+ * The redo log of one table. The generations are stored in files named
+ * "<basePath>.redo.<generation>". Each record in a file is a change to
+ * one cell: an 8-byte row index, a 4-byte column index, a 4-byte length,
+ * and the new value. A record torn by a crash is ignored when replaying.
+ */
+class RedoLog {
+public:
+    /**
+     * Creates a log. No file is created until a change is appended.
+     *
+     * @param basePath The path prefix of the files of the log.
+     *
+     * @param generation The generation to which changes are appended.
+     */
+    RedoLog(const std::string& basePath, const long generation);
+
+    /**
+     * Closes the file of the current generation.
+     */
+    ~RedoLog();
+
+    /**
+     * Encode the change to a cell and add it to a record.
+     *
+     * @param[out] record The record to which the change is appended.
+     *
+     * @param rowIdx The index of the row that was changed.
+     *
+     * @param colIdx The index of the column that was changed.
+     *
+     * @param value The new value of the cell.
+     */
+    static void addChange(std::string& record, const size_t rowIdx,
+                          const int colIdx, const std::string& value);
+
+    /**
+     * Append the changes made by a query to the current generation and
+     * flush them to disk. This method is MT-safe.
+     *
+     * @param record The changes encoded via addChange().
+     *
+     * @exception Exp This method throws an exception if the log could not
+     * be written.
+     */
+    void append(const std::string& record);
+
+    /**
+     * Determine if no changes have been appended since the log was created
+     * or last rotated.
+     *
+     * @return This method returns true if the current generation is empty.
+     */
+    bool empty();
+
+    /**
+     * Start a new generation. Subsequent changes are appended to it.
+     *
+     * @return The number of the new generation.
+     */
+    long rotate();
+
+    /**
+     * Delete the files of the generations before a given generation, i.e.,
+     * changes that are included in a checkpoint.
+     *
+     * @param generation The oldest generation to be retained.
+     */
+    void removeBefore(const long generation);
+
+    /**
+     * Delete the files of all the generations, e.g., once the changes have
+     * been saved.
+     */
+    void discard();
+
+    /**
+     * Apply the changes in a log to a table.
+     *
+     * @param table The table to be changed. It must not be in use by other
+     * threads.
+     *
+     * @param basePath The path prefix of the files of the log.
+     *
+     * @param generation The oldest generation to be replayed. Files of
+     * older generations are ignored.
+     *
+     * @return The number of cells that were changed.
+     */
+    static long replay(TableEntry& table, const std::string& basePath,
+                       const long generation);
+
+    /**
+     * Determine the first unused generation of a log, i.e., one more than
+     * the newest generation that has a file.
+     *
+     * @param basePath The path prefix of the files of the log.
+     *
+     * @return The generation to be used for new changes.
+     */
+    static long nextGeneration(const std::string& basePath);
+
+private:
+    /** Close the file of the current generation, if open */
+    void closeFile();
+
+    /** The path prefix of the files of this log */
+    const std::string basePath;
+
+    /** The generation to which changes are currently appended */
+    long generation;
+
+    /** The file descriptor of the current generation or -1 */
+    int fd = -1;
+
+    /** Flag set when a change is appended to the current generation */
+    bool hasChanges = false;
+
+    /** The mutex to serialize appends and rotations */
+    std::mutex mutex;
+};
+
+#endif /* REDO_LOG_H */
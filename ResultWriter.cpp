@@ -0,0 +1,111 @@
+/*
+ * Implementation of the buffered writer for the results of select queries.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include "ResultWriter.h"
+
+#include <utility>
+#include "Numeric.h"
+
+/**
+ * The buffers returned by the writers that ran on the calling thread. The
+ * buffers keep their capacity so that the memory is reserved only once.
+ */
+static thread_local std::vector<std::string> bufferPool;
+
+/** The maximum number of buffers kept in the pool of each thread */
+static constexpr size_t MaxPooledBuffers = 4;
+
+/**
+ * Helper method to obtain an output buffer from the calling thread's pool
+ * or a new buffer if the pool is empty.
+ *
+ * @return An empty buffer with a capacity of at least BufferSize.
+ */
+static std::string takeBuffer() {
+    std::string buffer;
+    if (!bufferPool.empty()) {
+        buffer = std::move(bufferPool.back());
+        bufferPool.pop_back();
+    }
+    buffer.clear();
+    buffer.reserve(ResultWriter::BufferSize);
+    return buffer;
+}
+
+ResultWriter::ResultWriter(std::ostream& os, const CSV& csv,
+                           const StrVec& colNames) :
+    os(os), colNames(colNames), buffer(takeBuffer()) {
+    for (const auto& colName : colNames) {
+        colIdx.push_back(csv.getColumnIndex(colName));
+    }
+}
+
+ResultWriter::~ResultWriter() {
+    if (!buffer.empty()) {
+        os.write(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+    if (bufferPool.size() < MaxPooledBuffers) {
+        bufferPool.push_back(std::move(buffer));
+    }
+}
+
+void ResultWriter::append(std::string_view data) {
+    if (buffer.size() + data.size() > BufferSize && !buffer.empty()) {
+        os.write(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+    buffer.append(data);
+}
+
+void ResultWriter::writeHeader() {
+    if (!wroteHeader) {  // Print the column names before the first row
+        std::string_view delim = "";
+        for (const auto& colName : colNames) {
+            append(delim);
+            append(colName);
+            delim = "\t";
+        }
+        append("\n");
+        wroteHeader = true;
+    }
+}
+
+void ResultWriter::writeColumns(const PackedRow& cells) {
+    writeHeader();
+    std::string_view delim = "";
+    for (size_t i = 0; (i < cells.size()); i++) {
+        append(delim);
+        append(cells.at(i));
+        delim = "\t";
+    }
+    append("\n");
+}
+
+void ResultWriter::writeRow(const PackedRow& row) {
+    writeHeader();
+    std::string_view delim = "";
+    for (const int idx : colIdx) {
+        append(delim);
+        append(row.at(idx));
+        delim = "\t";
+    }
+    append("\n");
+}
+
+void ResultWriter::writeCount(const long long numRows, std::string_view msg) {
+    char num[Numeric::MaxChars];
+    append(Numeric::format(numRows, num));
+    append(msg);
+    append("\n");
+    flush();
+}
+
+void ResultWriter::flush() {
+    os.write(buffer.data(), buffer.size());
+    buffer.clear();
+    os.flush();
+}
@@ -0,0 +1,122 @@
+#ifndef RESULT_WRITER_H
+#define RESULT_WRITER_H
+
+/*
+ * A buffered writer for the results of a select query. The column indexes
+ * are resolved once per query and the output is accumulated in a large,
+ * reusable buffer that is written to the output stream only when it fills
+ * up (or at the end of the query). This avoids a flush, and hence a
+ * system call, for every row that is printed.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "CSV.h"
+#include "PackedRow.h"
+
+/**
+ * The writer used by selectQuery to print column names, the selected rows,
+ * and the final row count.
+ */
+class ResultWriter {
+public:
+    /**
+     * Creates a writer for a given set of columns in a CSV.
+     *
+     * @param os The output stream to where the results are to be written.
+     *
+     * @param csv The CSV from where rows are printed. It is used to resolve
+     * the index of each column once.
+     *
+     * @param colNames The names of the columns to be printed (in order).
+     */
+    ResultWriter(std::ostream& os, const CSV& csv, const StrVec& colNames);
+
+    /**
+     * The destructor flushes any data remaining in the buffer.
+     */
+    ~ResultWriter();
+
+    /**
+     * Appends a row whose selected columns have already been gathered (in
+     * the order of the column names) to the output. The column names are
+     * written before the first row.
+     *
+     * @param cells A copy of the selected columns of a row of the CSV.
+     */
+    void writeColumns(const PackedRow& cells);
+
+    /**
+     * Appends the selected columns from a row that can be read without
+     * copying it, e.g., of a read-only table or of an immutable version of
+     * a table (see TableVersion).
+     *
+     * @param row The row whose columns are to be written.
+     */
+    void writeRow(const PackedRow& row);
+
+    /**
+     * Appends the final line of the form "5 row(s) selected." and flushes
+     * all the data to the output stream.
+     *
+     * @param numRows The number of rows.
+     *
+     * @param msg The message after the number, e.g., " row(s) selected.".
+     */
+    void writeCount(const long long numRows, std::string_view msg);
+
+    /**
+     * Writes any buffered data to the output stream and flushes it.
+     */
+    void flush();
+
+    /**
+     * Obtain the index in each row of the columns to be written.
+     *
+     * @return The column indexes, in the order they are written.
+     */
+    const std::vector<int>& getColumnIndexes() const { return colIdx; }
+
+    /** The size at which the buffer is written to the output stream */
+    static constexpr size_t BufferSize = 64 * 1024;
+
+private:
+    /**
+     * Writes the column names, if they have not already been written.
+     */
+    void writeHeader();
+
+    /**
+     * Appends data to the buffer, writing the buffer to the output stream
+     * if it is full.
+     *
+     * @param data The data to be appended.
+     */
+    void append(std::string_view data);
+
+    /** The output stream to where the data is finally written */
+    std::ostream& os;
+
+    /** The names of the columns, printed before the first row */
+    const StrVec& colNames;
+
+    /** The index in each row of the columns in colNames */
+    std::vector<int> colIdx;
+
+    /**
+     * The buffer of this writer. It is taken from a per-thread pool of
+     * buffers and returned to the pool by the destructor, so that writers
+     * that are alive at the same time (e.g., nested queries) never share a
+     * buffer.
+     */
+    std::string buffer;
+
+    /** Flag to track if the column names have been written */
+    bool wroteHeader = false;
+};
+
+#endif /* RESULT_WRITER_H */
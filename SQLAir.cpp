@@ -8,13 +8,42 @@
 
 #include "SQLAir.h"
 
+#include <fcntl.h>
+#include <strings.h>
+#include <unistd.h>
+
 #include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
 #include <fstream>
+#include <functional>
+#include <future>
 #include <memory>
+#include <sstream>
 #include <string>
+#include <string_view>
 #include <tuple>
 
+#include "AllocTracker.h"
+#include "AsyncFile.h"
+#include "ChunkParser.h"
+#include "CsvWriter.h"
 #include "HTTPFile.h"
+#include "HttpBody.h"
+#include "HttpClient.h"
+#include "HttpUpload.h"
+#include "LazyColumns.h"
+#include "PipelinedInput.h"
+#include "QueryArena.h"
+#include "RedoLog.h"
+#include "ResultWriter.h"
+#include "ShardIndex.h"
+#include "TableEntry.h"
+#include "TableSnapshot.h"
+#include "TableVersion.h"
 
 /**
  * A fixed HTTP response header that is used by the runServer method below.
@@ -28,30 +57,249 @@ const std::string HTTPRespHeader =
     "Content-Length: ";
 
 /**
- * A helper method called by the selectQuery function to print the values in
- * specified columns (by colNames) for a row in a CSV.
+ * Helper method to read an integer setting from an environment variable.
+ *
+ * @param name The name of the environment variable to be read.
+ *
+ * @param defVal The default value to be returned if the environment variable
+ * is not set or is not a valid number.
  *
- * @param row The row of the CSV whose values will be printed.
+ * @return The value of the environment variable or the default value.
+ */
+long getEnvLong(const char* name, const long defVal) {
+    const char* val = std::getenv(name);
+    if (val == nullptr) {
+        return defVal;
+    }
+    char* end = nullptr;
+    const long num = std::strtol(val, &end, 10);
+    return (end != val && *end == '\0') ? num : defVal;
+}
+
+/**
+ * Queries that take longer than this many milliseconds are logged to
+ * std::cerr. A negative value (the default) disables the slow-query log.
+ */
+const long SlowQueryMillis = getEnvLong("SQLAIR_SLOW_QUERY_MS", -1);
+
+/**
+ * The maximum number of concurrent connections used to download a remote
+ * CSV via HTTP range requests. A value less than 2 disables range requests.
+ */
+const long DownloadConnections = getEnvLong("SQLAIR_DOWNLOAD_CONNECTIONS", 4);
+
+/**
+ * The size of the first range requested when downloading a remote CSV and
+ * the minimum size of the subsequent ranges. Files smaller than this are
+ * downloaded with a single request.
+ */
+const long RangeBytes = getEnvLong("SQLAIR_RANGE_KB", 1024) * 1024;
+
+/**
+ * The number of threads used to format the rows of a CSV being saved. Zero
+ * (the default) uses all the cores.
+ */
+const int SaveThreads = getEnvLong("SQLAIR_SAVE_THREADS", 0);
+
+/**
+ * The number of rows at (or above) which a select reads an immutable
+ * version of the table (see TableVersion) instead of locking each row.
+ */
+const size_t VersionedScanRows =
+    getEnvLong("SQLAIR_VERSIONED_SCAN_ROWS", 50000);
+
+/**
+ * The number of seconds after which the session of a web-client that has
+ * not sent a request is discarded.
+ */
+const long SessionIdleSecs = getEnvLong("SQLAIR_SESSION_IDLE_SECS", 1800);
+
+/** The number of seconds between checks for idle sessions */
+const long SessionPruneSecs = 10;
+
+/** The HTTP request header that identifies the session of a web-client */
+const std::string SessionHeader = "X-SQLAir-Session:";
+
+/** The maximum number of shards of a partitioned table (see "use") */
+const long MaxShards = 4096;
+
+/** The approximate size of each block of rows parsed by a streamed select */
+const size_t StreamBlockBytes = 1024 * 1024;
+
+/**
+ * The number of bytes at the end of the loaded part of a file that are
+ * hashed to check if the file was only appended to.
+ */
+const long FingerprintBytes = 4096;
+
+/**
+ * Helper method to hash the bytes preceding a given offset in a file.
  *
- * @param colNames A vector of strings containing column names in the CSV from
- * where we will print values.
+ * @param path The path to the file.
  *
- * @param csv The CSV object that contains the row, and is used to get the
- * correct indices for values in the row.
+ * @param size The offset in the file. Up to FingerprintBytes bytes before
+ * this offset are hashed.
  *
- * @param os The output stream used to print the values from the row.
+ * @return The hash of the bytes or 0 if they could not be read.
  */
-void display(const CSVRow& row, const StrVec& colNames, const CSV& csv,
-             std::ostream& os, int numRows) {
-    if (numRows == 1) {  // Print the column names if we select a row
-        os << colNames << std::endl;
+size_t fingerprint(const std::string& path, const long size) {
+    std::ifstream file(path, std::ios::binary);
+    const long start = std::max(0L, size - FingerprintBytes);
+    std::string bytes(size - start, '\0');
+    if (!file.seekg(start) || !file.read(bytes.data(), bytes.size())) {
+        return 0;
     }
-    std::string delim = "";
-    for (const auto& colName : colNames) {
-        os << delim << row.at(csv.getColumnIndex(colName));
-        delim = "\t";
+    return std::hash<std::string>{}(bytes);
+}
+
+/**
+ * Helper method to record information about the part of a local file that
+ * has been loaded into a table. The information is used to detect changes
+ * to the file (see SQLAir::reloadTable).
+ *
+ * @param table The table into which the file was loaded.
+ *
+ * @param path The path to the file.
+ *
+ * @param size The number of bytes of the file that were loaded.
+ */
+void recordSource(TableEntry& table, const std::string& path,
+                  const long size) {
+    std::error_code ec;
+    const auto mtime = std::filesystem::last_write_time(path, ec);
+    table.sourceMTime = (ec ? 0 : mtime.time_since_epoch().count());
+    table.sourceFingerprint = fingerprint(path, size);
+    table.sourceSize = size;
+}
+
+/**
+ * Helper method to flush a file (or directory) to disk via fsync.
+ *
+ * @param path The path to the file or directory to be flushed.
+ *
+ * @exception Exp This method throws an exception if the file could not be
+ * flushed.
+ */
+void syncFile(const std::string& path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    const bool synced = (fd != -1 && fsync(fd) == 0);
+    if (fd != -1) {
+        close(fd);
+    }
+    if (!synced) {
+        throw Exp("Unable to flush " + path + " to disk");
+    }
+}
+
+/**
+ * Helper method to format the time and allocations of a query in a
+ * consistent manner for "explain analyze" and the slow-query log.
+ *
+ * @param millis The elapsed time for the query in milliseconds.
+ *
+ * @param allocs The allocations performed by the query.
+ *
+ * @return A string of the form "Execution time: 1.25 ms, allocations: 15
+ * (2048 bytes)".
+ */
+std::string formatQueryStats(const double millis,
+                             const AllocTracker::Stats& allocs) {
+    std::ostringstream os;
+    os << "Execution time: " << millis << " ms, allocations: ";
+    if (AllocTracker::enabled()) {
+        os << allocs.count << " (" << allocs.bytes << " bytes)";
+    } else {
+        os << "not tracked (compile with -DSQLAIR_TRACK_ALLOC)";
     }
-    os << std::endl;
+    return os.str();
+}
+
+// Configure the catalog from environment variables
+SQLAir::SQLAir() {
+    const char* dir = std::getenv("SQLAIR_CACHE_DIR");
+    cacheDir = (dir != nullptr && *dir != '\0') ? dir :
+        (std::filesystem::temp_directory_path() / "sqlair-cache").string();
+    inMemoryCSV.setMemoryBudget(getEnvLong("SQLAIR_MEMORY_BUDGET_MB", 0) *
+                                1024 * 1024);
+    watchFiles = (getEnvLong("SQLAIR_WATCH_FILES", 1) != 0);
+    // Snapshot evicted local files so that they can be reloaded quickly
+    inMemoryCSV.setEvictHandler([this](const std::string& fileOrURL,
+                                       TableEntry& table) {
+        const std::string stamp = TableSnapshot::sourceStamp(fileOrURL);
+        // Lazily loaded tables are quick to reload from the file itself
+        if (!stamp.empty() && table.lazy == nullptr) {
+            std::filesystem::create_directories(cacheDir);
+            TableSnapshot::save(TableVersion::freeze(table),
+                                snapshotPath(fileOrURL), stamp);
+        }
+    });
+    // The workers for the shards of partitioned tables
+    shardExecutor = std::make_unique<ShardExecutor>(getEnvLong(
+        "SQLAIR_SHARD_WORKERS", std::thread::hardware_concurrency()));
+    // Periodically checkpoint tables with unsaved changes
+    const long checkpointSecs = getEnvLong("SQLAIR_CHECKPOINT_SECS", 0);
+    if (checkpointSecs > 0) {
+        checkpointing = true;
+        saveJobs.every(checkpointSecs * 1000, [this] { checkpointTables(); });
+    }
+}
+
+// Record the tables pinned before a query
+SQLAir::QueryCleanup::QueryCleanup() : numTables(queryTables.size()) {
+}
+
+// Unpin the tables used by a query and close its stream, if any
+SQLAir::QueryCleanup::~QueryCleanup() {
+    queryTables.resize(numTables);
+    streamQuery = false;
+    streamScan.reset();
+}
+
+// Process a query while measuring its execution time and allocations
+bool SQLAir::process(const std::string& sql, std::ostream& os) {
+    // Track the allocations made by this query, including those made by
+    // the threads working for it (see AllocTracker::wrap).
+    const AllocTracker::Scope tracking(AllocTracker::newContext());
+    // Use an arena for the short-lived objects created by this query
+    QueryArena arena;
+    // Unpin the tables used by this query when it finishes (even if the
+    // query throws an exception).
+    const QueryCleanup cleanup;
+    // Check for and strip an optional "explain analyze" prefix without
+    // creating temporary strings.
+    const std::string_view Prefix[] = {"explain", "analyze"};
+    std::string_view toRun(sql);
+    bool explain = true;
+    for (const auto& word : Prefix) {
+        toRun.remove_prefix(std::min(toRun.find_first_not_of(" \t\r\n"),
+                                     toRun.size()));
+        explain = explain && toRun.size() > word.size() &&
+                  std::isspace(toRun[word.size()]) &&
+                  strncasecmp(toRun.data(), word.data(), word.size()) == 0;
+        if (explain) {
+            toRun.remove_prefix(word.size());
+        }
+    }
+    toRun = (explain ? toRun : std::string_view(sql));
+
+    const auto startAllocs = AllocTracker::current();
+    const auto startTime = std::chrono::steady_clock::now();
+    const bool result = SQLAirBase::process(
+        (explain ? std::string(toRun) : sql), os);
+    const auto allocs = AllocTracker::current() - startAllocs;
+    const std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - startTime;
+
+    if (explain) {
+        os << formatQueryStats(elapsed.count(), allocs) << std::endl;
+    }
+    if (SlowQueryMillis >= 0 && elapsed.count() > SlowQueryMillis) {
+        // Build the whole line first so that lines from different threads
+        // do not get interleaved.
+        std::cerr << "Slow query: " + Helper::trim(std::string(toRun)) +
+                     " -- " + formatQueryStats(elapsed.count(), allocs) + "\n";
+    }
+    return result;
 }
 
 // API method to perform operations associated with a "select" statement
@@ -61,61 +309,398 @@ void SQLAir::selectQuery(CSV& csv, bool mustWait, StrVec colNames,
                          const std::string& value, std::ostream& os) {
     // Convert any "*" to suitable column names
     colNames = (colNames[0] == "*") ? csv.getColumnNames() : colNames;
-    int numRows = 0;
-    CSVRow selRow;
-    // Print each row that matches an optional condition.
-    for (auto& row : csv) {
-        bool rowChosen = false;
+    if (streamScan != nullptr && &csv == &streamScan->header) {
+        streamSelect(colNames, whereColIdx, cond, value, os);
+        return;
+    }
+    // Each attempt uses its own arena so that rerunning the query after
+    // waiting does not keep the memory used by the earlier attempts.
+    while (true) {
         {
-            std::scoped_lock<std::mutex> lock(row.rowMutex);  // begin CS
-            rowChosen = (whereColIdx == -1 ||
-                         matches(row.at(whereColIdx), cond, value));
-            selRow = row;
-        }                 // end CS
-        if (rowChosen) {  // make sure I/O is outside of CS
-            display(selRow, colNames, csv, os, ++numRows);
+            QueryArena attempt(true);
+            // The results are buffered and written in large blocks
+            ResultWriter writer(os, csv, colNames);
+            const int numRows = selectAttempt(csv, colNames, whereColIdx,
+                                              cond, value, writer);
+            if (!mustWait || numRows > 0) {
+                writer.writeCount(numRows, " row(s) selected.");
+                return;
+            }
         }
-    }
-    if (mustWait && numRows == 0) {  // we have to wait and no rows selected
+        // we have to wait and no rows selected. Rerun after waiting.
         std::unique_lock<std::mutex> lock(csv.csvMutex);
         csv.csvCondVar.wait(lock);
-        // rerun the selectQuery method with the same arguments after waiting
-        selectQuery(csv, mustWait, colNames, whereColIdx, cond, value, os);
+    }
+}
+
+// Run a select query once, printing the matching rows via a writer
+int SQLAir::selectAttempt(CSV& csv, const StrVec& colNames,
+                          const int whereColIdx, const std::string& cond,
+                          const std::string& value, ResultWriter& writer) {
+    TableEntry& table = tableOf(csv);
+    ensureColumns(table, colNames, whereColIdx);
+    int numRows = 0;
+    if (table.readOnly) {
+        // The rows never change. Hence no locks or copies are needed.
+        numRows = selectReadOnly(table, whereColIdx, cond, value, writer);
     } else {
-        os << numRows << " row(s) selected." << std::endl;
+        // Rows are not appended to the CSV (see reloadTable) while reading
+        std::shared_lock<std::shared_mutex> tableLock(table.tableMutex);
+        if (table.size() >= VersionedScanRows && table.shards == nullptr) {
+            // A long scan reads an immutable version without holding any
+            // locks so that it neither blocks nor observes concurrent
+            // updates. Partitioned tables are scanned by their shards.
+            tableLock.unlock();
+            numRows = selectVersion(table, whereColIdx, cond, value, writer);
+        } else {
+            const WhereClause where = prepareWhere(table, whereColIdx, cond,
+                                                   value);
+            numRows = selectRows(table, where, matchingRows(table, where),
+                                 writer);
+        }
     }
+    return numRows;
 }
 
 void SQLAir::updateQuery(CSV& csv, bool mustWait, StrVec colNames,
                          StrVec values, const int whereColIdx,
                          const std::string& cond, const std::string& value,
                          std::ostream& os) {
+    // Each attempt uses its own arena (see selectQuery)
     int numRows = 0;
-    // Update each row that matches an optional condition.
-    for (auto& row : csv) {
-        std::scoped_lock<std::mutex> lock(row.rowMutex);  // begin CS
-        // Determine if this row matches "where" clause condition, if any
-        // see SQLAirBase::matches() helper method.
-        if (whereColIdx == -1 || matches(row.at(whereColIdx), cond, value)) {
-            numRows++;
-            for (size_t i = 0; i < colNames.size(); i++) {
-                row[csv.getColumnIndex(colNames[i])] = values[i];
-            }
+    while (true) {
+        {
+            QueryArena attempt(true);
+            numRows = updateAttempt(csv, colNames, values, whereColIdx, cond,
+                                    value);
         }
-    }  // end CS
-
-    if (mustWait && numRows == 0) {  // we have to wait and no rows updated
+        if (!mustWait || numRows > 0) {
+            break;
+        }
+        // we have to wait and no rows updated. Rerun after waiting.
         std::unique_lock<std::mutex> lock(csv.csvMutex);
         csv.csvCondVar.wait(lock);
-        // after waiting run updateQuery method again with same arguments
-        updateQuery(csv, mustWait, colNames, values, whereColIdx, cond, value,
-                    os);
+    }
+    os << numRows << " row(s) updated." << std::endl;
+    if (numRows > 0) {  // notify threads if a row was updated
+        csv.csvCondVar.notify_all();
+    }
+}
+
+// Run an update query once and return the number of rows updated
+int SQLAir::updateAttempt(CSV& csv, const StrVec& colNames,
+                          const StrVec& values, const int whereColIdx,
+                          const std::string& cond, const std::string& value) {
+    TableEntry& table = tableOf(csv);
+    ensureColumns(table, colNames, whereColIdx);
+    int numRows = 0;
+    long memoryChange = 0;
+    // Rows are not appended to the CSV (see reloadTable) while updating
+    std::shared_lock<std::shared_mutex> tableLock(table.tableMutex);
+    if (table.readOnly) {
+        throw Exp("Unable to update a read-only table.");
+    }
+    const WhereClause where = prepareWhere(table, whereColIdx, cond, value);
+    // The changes to be appended to the redo log, if any
+    std::string redoRecord;
+    // Changing keys moves rows between shards. The shards are not used
+    // until they are rebuilt below.
+    bool keyChanged = false;
+    {
+        // Resolve the columns to be updated once. The numeric shadow of
+        // any updated column that is cached must be kept consistent with
+        // the rows. Columns are not cached until the update is finished.
+        NumericShadow::WriteScope shadowWrite(table.numericShadow);
+        std::vector<std::tuple<int, double, std::vector<double>*>> targets;
+        for (size_t i = 0; i < colNames.size(); i++) {
+            const int colIdx = csv.getColumnIndex(colNames[i]);
+            targets.emplace_back(colIdx, NumericShadow::toShadow(values[i]),
+                                 table.numericShadow.find(colIdx));
+        }
+        // Only the rows in one shard can match "key = value"
+        const std::vector<size_t>* route = routeRows(table, where);
+        for (const auto& [colIdx, numVal, shadow] : targets) {
+            if (table.shards != nullptr &&
+                colIdx == table.shards->getKeyColumn()) {
+                keyChanged = true;
+                table.shards->stale = true;
+            }
+        }
+        // Update each row that matches an optional condition.
+        const size_t numCandidates = (route != nullptr) ? route->size() :
+            table.size();
+        for (size_t i = 0; (i < numCandidates); i++) {
+            const size_t rowIdx = (route != nullptr) ? (*route)[i] : i;
+            {
+                auto& row = table.row(rowIdx);
+                std::scoped_lock<std::mutex> lock(row.rowMutex);
+                // Determine if this row matches "where" clause condition,
+                // if any see rowMatches() helper method.
+                if (!rowMatches(row, rowIdx, where)) {
+                    continue;
+                }
+            }
+            // Change the copy of the row that is not shared with any
+            // version. Queries may still be reading the copy in the segment
+            // it replaced (see TableEntry::staleRow), so it is locked too.
+            auto& row = table.writableRow(rowIdx);
+            TableRow* const stale = table.staleRow(rowIdx);
+            std::mutex noStale;
+            std::scoped_lock<std::mutex, std::mutex> lock(row.rowMutex,
+                (stale != nullptr) ? stale->rowMutex : noStale);  // begin CS
+            if (rowMatches(row, rowIdx, where)) {  // It may have changed
+                numRows++;
+                for (size_t t = 0; t < targets.size(); t++) {
+                    const auto& [colIdx, numVal, shadow] = targets[t];
+                    memoryChange -= row.capacity();
+                    row.set(colIdx, values[t]);  // Reuses buffer if it fits
+                    memoryChange += row.capacity();
+                    if (shadow != nullptr && rowIdx < shadow->size()) {
+                        (*shadow)[rowIdx] = numVal;
+                    }
+                    if (table.redoLog != nullptr) {
+                        RedoLog::addChange(redoRecord, rowIdx, colIdx,
+                                           values[t]);
+                    }
+                }
+            }
+        }  // end CS
+    }  // The update is no longer in progress
+    if (numRows > 0) {
+        // The table is not evicted until these changes are saved
+        table.dirty = true;
+        table.changes++;
+        table.memoryUsage += memoryChange;
+        // Log the changes while holding the table lock so that a checkpoint
+        // (which holds it exclusively) never splits them.
+        if (table.redoLog != nullptr) {
+            table.redoLog->append(redoRecord);
+        }
+    }
+    tableLock.unlock();
+    if (keyChanged) {
+        std::unique_lock<std::shared_mutex> rebuildLock(table.tableMutex);
+        if (table.shards != nullptr && table.shards->stale) {
+            table.shards = ShardIndex::build(table,
+                table.shards->getKeyColumn(), table.shards->size());
+        }
+    }
+    return numRows;
+}
+
+// Find the rows that match a where clause, reading only the where column
+std::pmr::vector<size_t> SQLAir::matchingRows(TableEntry& table,
+                                              const WhereClause& where) {
+    std::pmr::vector<size_t> rowIdxs(QueryArena::resource());
+    if (where.colIdx == -1) {
+        return rowIdxs;  // All rows match. No need to list them.
+    }
+    // Check the given rows (or all rows if candidates is nullptr)
+    const auto check = [&](const std::vector<size_t>* candidates,
+                           auto& matches) {
+        const size_t numRows = (candidates != nullptr) ? candidates->size() :
+            table.size();
+        for (size_t i = 0; (i < numRows); i++) {
+            const size_t rowIdx = (candidates != nullptr) ?
+                (*candidates)[i] : i;
+            auto& row = table.row(rowIdx);
+            std::scoped_lock<std::mutex> lock(row.rowMutex);
+            if (rowMatches(row, rowIdx, where)) {
+                matches.push_back(rowIdx);
+            }
+        }
+    };
+    const std::shared_ptr<ShardIndex> shards = table.shards;
+    if (const auto route = routeRows(table, where); route != nullptr) {
+        check(route, rowIdxs);  // A point query checks only one shard
+    } else if (shards == nullptr || shards->stale) {
+        check(nullptr, rowIdxs);
     } else {
-        os << numRows << " row(s) updated." << std::endl;
-        if (numRows > 0) {  // notify threads if a row was updated
-            csv.csvCondVar.notify_all();
+        // Check the shards in parallel, each on the worker for the shard
+        std::vector<std::vector<size_t>> matches(shards->size());
+        std::vector<std::future<void>> done;
+        for (size_t shard = 0; (shard < shards->size()); shard++) {
+            done.push_back(shardExecutor->submit(shard, [&, shard] {
+                check(&shards->getRows(shard), matches[shard]); }));
         }
+        // All the shards must finish (even on errors) as they use locals
+        for (auto& shard : done) {
+            shard.wait();
+        }
+        for (auto& shard : done) {
+            shard.get();  // Rethrows errors
+        }
+        // Merge the matches of the shards to restore the order of the rows
+        for (const auto& shard : matches) {
+            rowIdxs.insert(rowIdxs.end(), shard.begin(), shard.end());
+        }
+        std::sort(rowIdxs.begin(), rowIdxs.end());
     }
+    return rowIdxs;
+}
+
+// Find the shard that holds the rows that may match a where clause
+const std::vector<size_t>* SQLAir::routeRows(const TableEntry& table,
+                                             const WhereClause& where) const {
+    const ShardIndex* const shards = table.shards.get();
+    if (shards == nullptr || shards->stale || where.colIdx == -1 ||
+        where.colIdx != shards->getKeyColumn() || *where.cond != "=") {
+        return nullptr;
+    }
+    return &shards->getRows(shards->shardOf(*where.value));
+}
+
+// Gather and print the selected columns of the rows found by matchingRows
+int SQLAir::selectRows(TableEntry& table, const WhereClause& where,
+                       const std::pmr::vector<size_t>& rowIdxs,
+                       ResultWriter& writer) {
+    const std::vector<int>& colIdxs = writer.getColumnIndexes();
+    // The selected cells of each row are packed into one buffer in the
+    // query's arena. Assigning to it reuses the buffer of the previous row.
+    PackedRow selCells(QueryArena::resource());
+    std::pmr::vector<std::string_view> cells(QueryArena::resource());
+    const size_t numRows = (where.colIdx == -1) ? table.size() :
+        rowIdxs.size();
+    int numSelected = 0;
+    for (size_t i = 0; (i < numRows); i++) {
+        const size_t rowIdx = (where.colIdx == -1) ? i : rowIdxs[i];
+        auto& row = table.row(rowIdx);
+        bool rowChosen = false;
+        {
+            std::scoped_lock<std::mutex> lock(row.rowMutex);  // begin CS
+            // The row may have been updated since it was found
+            rowChosen = rowMatches(row, rowIdx, where);
+            if (rowChosen) {
+                cells.clear();
+                for (const int colIdx : colIdxs) {
+                    cells.emplace_back(row.at(colIdx));
+                }
+                selCells.assign(cells.begin(), cells.end());
+            }
+        }                 // end CS
+        if (rowChosen) {  // make sure I/O is outside of CS
+            writer.writeColumns(selCells);
+            numSelected++;
+        }
+    }
+    return numSelected;
+}
+
+// Print the matching rows of a read-only CSV, without any locks
+int SQLAir::selectReadOnly(TableEntry& table, const int whereColIdx,
+                           const std::string& cond, const std::string& value,
+                           ResultWriter& writer) {
+    const WhereClause where = prepareWhere(table, whereColIdx, cond, value);
+    int numRows = 0;
+    for (size_t rowIdx = 0; (rowIdx < table.size()); rowIdx++) {
+        const TableRow& row = table.row(rowIdx);
+        if (rowMatches(row, rowIdx, where)) {
+            writer.writeRow(row);
+            numRows++;
+        }
+    }
+    return numRows;
+}
+
+// Print the matching rows from a version of a CSV, without any locks
+int SQLAir::selectVersion(TableEntry& table, const int whereColIdx,
+                          const std::string& cond, const std::string& value,
+                          ResultWriter& writer) {
+    TableVersion version;
+    {
+        // Wait for in-flight updates so that the version is consistent
+        std::unique_lock<std::shared_mutex> tableLock(table.tableMutex);
+        version = TableVersion::freeze(table);
+    }
+    // The numeric shadow tracks the table, not the version. So values are
+    // compared as strings (see matches()).
+    WhereClause where;
+    where.colIdx = whereColIdx;
+    where.cond = &cond;
+    where.value = &value;
+    int numRows = 0;
+    size_t rowIdx = 0;
+    for (const auto& segment : version.getSegments()) {
+        for (const auto& row : *segment) {
+            if (rowMatches(row, rowIdx++, where)) {
+                writer.writeRow(row);
+                numRows++;
+            }
+        }
+    }
+    return numRows;
+}
+
+// Materialize the columns of a lazily loaded table used by a query
+void SQLAir::ensureColumns(TableEntry& table, const StrVec& colNames,
+                           const int whereColIdx) {
+    if (table.lazy == nullptr) {
+        return;  // All the columns were loaded
+    }
+    std::vector<int> colIdxs = {whereColIdx};
+    for (const auto& colName : colNames) {
+        colIdxs.push_back(table.csv.getColumnIndex(colName));
+    }
+    {
+        std::shared_lock<std::shared_mutex> tableLock(table.tableMutex);
+        if (!table.lazy->missing(colIdxs)) {
+            return;
+        }
+    }
+    // Rows are changed. So no other query may use the table meanwhile.
+    std::unique_lock<std::shared_mutex> tableLock(table.tableMutex);
+    if (table.lazy->materialize(table, colIdxs)) {
+        // Cached copies of the rows are stale
+        table.numericShadow.clear();
+        table.memoryUsage = table.estimateMemory();
+    }
+}
+
+// The indexes of all the columns of a table
+std::vector<int> SQLAir::allColumns(const CSV& csv) {
+    std::vector<int> colIdxs(csv.getColumnCount());
+    for (size_t i = 0; (i < colIdxs.size()); i++) {
+        colIdxs[i] = i;
+    }
+    return colIdxs;
+}
+
+// Prepare a where clause once per query to streamline checking each row
+SQLAir::WhereClause SQLAir::prepareWhere(TableEntry& table,
+                                         const int whereColIdx,
+                                         const std::string& cond,
+                                         const std::string& value) {
+    WhereClause where;
+    where.colIdx = whereColIdx;
+    where.cond = &cond;
+    where.value = &value;
+    if (whereColIdx != -1 && Numeric::isNumericCond(cond) &&
+        Numeric::parse(value, where.numValue)) {
+        // Compare numbers using the cached numeric values of the column
+        where.shadow = table.numericShadow.column(table, whereColIdx);
+    }
+    return where;
+}
+
+// Check if a row satisfies a prepared where clause
+bool SQLAir::rowMatches(const PackedRow& row, const size_t rowIdx,
+                        const WhereClause& where) const {
+    if (where.colIdx == -1) {
+        return true;  // No where clause. All rows match.
+    }
+    if (where.shadow != nullptr && rowIdx < where.shadow->size()) {
+        const double colVal = (*where.shadow)[rowIdx];
+        // "=" and "<>" compare the text. Different numbers must have
+        // different text, so only equal numbers need the text compared.
+        if (!std::isnan(colVal) && colVal != where.numValue) {
+            return *where.cond == "<>";
+        }
+    }
+    // The base class compares strings. The cell is copied to a buffer that
+    // is reused for all the rows checked by the calling thread.
+    thread_local std::string cell;
+    cell.assign(row.at(where.colIdx));
+    return matches(cell, *where.cond, *where.value);
 }
 
 void SQLAir::insertQuery(CSV& csv, bool mustWait, StrVec colNames,
@@ -133,16 +718,31 @@ void SQLAir::deleteQuery(CSV& csv, bool mustWait, const int whereColIdx,
 void SQLAir::clientThread(TcpStreamPtr client) {
     // Read the HTTP request from the client, process it, and send an
     // HTTP response back to the client.
-    std::string request, response, hdr;
+    QueryArena arena;  // Memory for this request is freed in one shot
+    std::string request, response, hdr, clientID;
     *client >> request >> request;
 
     while (getline(*client, hdr) && !hdr.empty() && hdr != "\r") {
+        // Clients on one host (e.g., web pages) may use separate sessions
+        if (strncasecmp(hdr.c_str(), SessionHeader.c_str(),
+                        SessionHeader.size()) == 0 &&
+            std::istringstream(hdr.substr(SessionHeader.size())) >> clientID) {
+            clientID = "session " + clientID;
+        }
+    }
+    if (clientID.empty()) {
+        // Use the session associated with the client's address
+        boost::system::error_code ec;
+        const auto endpoint = client->socket().remote_endpoint(ec);
+        clientID = (ec ? "" : endpoint.address().to_string());
     }
+    const std::shared_ptr<Session> session = findSession(clientID);
+    threadSession = session.get();
 
     if (request.find("/sql-air?query=") == 0) {  // run sql-air query
         request = request.substr(15);            // remove "/sql-air?query="
         request = Helper::url_decode(request);
-        std::ostringstream os;
+        ArenaStream os;
         try {  // process the requested query
             process(request, os);
         } catch (const std::exception& exp) {
@@ -153,13 +753,58 @@ void SQLAir::clientThread(TcpStreamPtr client) {
         request = request.substr(1);  // remove initial / from request string
         *client << http::file(request);
     }
+    threadSession = nullptr;
+    pruneSessions();
     numThreads--;          // decrement the number of threads
     thrCond.notify_one();  // notify a thread that one has finished running
 }
 
+// Obtain (or create) the session of a web-client
+std::shared_ptr<SQLAir::Session> SQLAir::findSession(
+    const std::string& clientID) {
+    const std::shared_ptr<Session> session = sessions.findOrInsert(clientID,
+        [] { return std::make_shared<Session>(); }).first;
+    session->lastUsed.store(
+        std::chrono::steady_clock::now().time_since_epoch().count(),
+        std::memory_order_relaxed);
+    return session;
+}
+
+// Discard the sessions of web-clients that have been idle for a while
+void SQLAir::pruneSessions() {
+    using namespace std::chrono;
+    const long now = steady_clock::now().time_since_epoch().count();
+    const long interval = duration_cast<steady_clock::duration>(
+        seconds(SessionPruneSecs)).count();
+    long last = lastPrune.load(std::memory_order_relaxed);
+    if (now - last < interval ||
+        !lastPrune.compare_exchange_strong(last, now)) {
+        return;  // Checked recently or being checked by another thread
+    }
+    const long idle = duration_cast<steady_clock::duration>(
+        seconds(SessionIdleSecs)).count();
+    sessions.eraseIf([now, idle](const std::string&,
+                                 const std::shared_ptr<Session>& session) {
+        // The map holds the only reference unless a request uses it
+        return session.use_count() == 1 &&
+            now - session->lastUsed.load(std::memory_order_relaxed) >= idle;
+    });
+}
+
 // The method to have this class run as a web-server.
 void SQLAir::runServer(boost::asio::ip::tcp::acceptor& server,
                        const int maxThr) {
+    // Load the configured tables before accepting any connections
+    if (const char* tables = std::getenv("SQLAIR_PRELOAD")) {
+        StrVec names;
+        std::istringstream is(tables);
+        for (std::string name; std::getline(is, name, ',');) {
+            if (!(name = Helper::trim(name)).empty()) {
+                names.push_back(name);
+            }
+        }
+        preload(names, std::cout);
+    }
     // Process client connections one-by-one...forever
     while (true) {
         // Check the number of background threads running
@@ -178,106 +823,750 @@ void SQLAir::runServer(boost::asio::ip::tcp::acceptor& server,
     }
 }
 
-/**
- * Helper method to setup a TCP stream for downloading data from an
- * web-server. The basis for this method was taken from the LoginSentry.cpp file
- * from HW3.
- *
- * @param host The host name of the web-server. Host names can be of
- * the form "www.miamioh.edu" or "ceclnx01.cec.miamioh.edu".  This
- * information is typically extracted from a given URL.
- *
- * @param path The path to the file being download.  An example of
- * this value is "/~raodm/ssh_logs/full_logs.txt". This information is typically
- * extracted from a given URL.
- *
- * @param socket The TCP stream (aka socket) to be setup by this
- * method.  After a successful call to this method, this stream will
- * contain the response from the web-server to be processed.
- *
- * @param port An optional port number. The default port number is "80".
- *
- */
-void setupDownload(const std::string& hostName, const std::string& path,
-                   boost::asio::ip::tcp::iostream& data,
-                   const std::string& port = "80") {
-    // Create a boost socket and request the log file from the server.
-    data.connect(hostName, port);
+// The session of the request being processed by each thread
+thread_local SQLAir::Session* SQLAir::threadSession = nullptr;
+
+// The tables pinned by the query being processed by each thread
+thread_local std::vector<PinnedTable> SQLAir::queryTables;
+
+// The state of the streamed select (if any) being processed by each thread
+thread_local bool SQLAir::streamQuery = false;
+thread_local std::unique_ptr<SQLAir::StreamScan> SQLAir::streamScan;
 
-    // check to make sure connection is good
-    if (!data.good()) {
-        throw Exp("Unable to connect to " + hostName + " at port " + port);
+// Strip the "stream" prefix and let the base class tokenize the rest
+std::tuple<StrVec, bool, int> SQLAir::preprocess(const std::string& sql)
+    const {
+    const std::string_view Prefix = "stream";
+    std::string_view toRun(sql);
+    toRun.remove_prefix(std::min(toRun.find_first_not_of(" \t\r\n"),
+                                 toRun.size()));
+    if (toRun.size() <= Prefix.size() || !std::isspace(toRun[Prefix.size()])
+        || strncasecmp(toRun.data(), Prefix.data(), Prefix.size()) != 0) {
+        return SQLAirBase::preprocess(sql);
     }
+    toRun.remove_prefix(Prefix.size());
+    auto result = SQLAirBase::preprocess(std::string(toRun));
+    if (std::get<2>(result) != SelectCmd) {
+        throw Exp("Only select queries can be streamed");
+    }
+    if (std::get<1>(result)) {
+        throw Exp("A streamed select cannot wait");
+    }
+    streamQuery = true;
+    return result;
+}
 
-    // send HTTP request to server
-    data << "GET " << path << " HTTP/1.1\r\n"
-         << "Host: " << hostName << "\r\n"
-         << "Connection: Close\r\n\r\n";
+// Open a file to be streamed and load just its header line
+SQLAir::StreamScan::StreamScan(const std::string& path) : input(path) {
+    std::string line;
+    if (!input.good() || !std::getline(input, line)) {
+        throw Exp("Unable to read " + path);
+    }
+    std::istringstream hdr(line + "\n");
+    header.load(hdr);
+}
 
-    // read the first line and make sure it contains "200 OK"
-    std::string status;
-    getline(data, status);
-    if (status.find("200 OK") == std::string::npos) {
-        status = Helper::trim(status);
-        throw Exp("Error (" + status + ") getting " + path + " from " +
-                  hostName + " at port " + port);
+// Parse and filter a file in blocks of rows without caching it
+void SQLAir::streamSelect(const StrVec& colNames, const int whereColIdx,
+                          const std::string& cond, const std::string& value,
+                          std::ostream& os) {
+    const CSV& header = streamScan->header;
+    ResultWriter writer(os, header, colNames);
+    // There is no numeric shadow. So values are compared as strings (see
+    // matches()).
+    WhereClause where;
+    where.colIdx = whereColIdx;
+    where.cond = &cond;
+    where.value = &value;
+    // Each block is parsed by the standard loader. So it starts with the
+    // header line.
+    std::string headerLine;
+    for (const auto& colName : header.getColumnNames()) {
+        headerLine += (headerLine.empty() ? "\"" : ",\"") + colName + "\"";
     }
+    headerLine += '\n';
+    int numRows = 0;
+    std::string block, line;
+    // Each parsed row is packed into this buffer to be checked
+    PackedRow packed(QueryArena::resource());
+    for (bool more = true; more;) {
+        // Gather complete lines until the block is large enough
+        block = headerLine;
+        while (block.size() < StreamBlockBytes &&
+               (more = static_cast<bool>(std::getline(streamScan->input,
+                                                      line)))) {
+            block += line;
+            block += '\n';
+        }
+        CSV rows;
+        std::istringstream is(block);
+        rows.load(is);
+        for (const auto& row : rows) {
+            packed.assign(row.begin(), row.end());
+            if (rowMatches(packed, 0, where)) {
+                writer.writeRow(packed);
+                numRows++;
+            }
+        }
+    }
+    writer.writeCount(numRows, " row(s) selected.");
+}
+
+// The snapshot of a table is named using a hash of its path or URL
+std::string SQLAir::snapshotPath(const std::string& fileOrURL) const {
+    const size_t hash = std::hash<std::string>{}(fileOrURL);
+    return cacheDir + "/" + std::to_string(hash) + ".snap";
+}
+
+// Checkpoints are stored alongside the snapshots of evicted tables
+std::string SQLAir::checkpointPath(const std::string& fileOrURL) const {
+    const size_t hash = std::hash<std::string>{}(fileOrURL);
+    return cacheDir + "/" + std::to_string(hash) + ".ckpt";
+}
 
-    // read the rest of the header lines
-    for (std::string hdr; getline(data, hdr) && !hdr.empty() && hdr != "\r";) {
+// Get the session of the client whose request is being processed
+SQLAir::Session& SQLAir::currentSession() {
+    return (threadSession != nullptr ? *threadSession : consoleSession);
+}
+
+// Load a CSV from a web-server, reusing the cached copy if it is unchanged
+void SQLAir::loadFromURL(TableEntry& table, const std::string& hostName,
+                         const std::string& port, const std::string& path,
+                         const std::string& cacheFile) {
+    CSV& csv = table.csv;
+    // Revalidate the cached copy (if any) with the server
+    const std::string cachedStamp = (cacheFile.empty() ? "" :
+                                     TableSnapshot::readStamp(cacheFile));
+    HttpHeaders reqHeaders = HttpClient::conditionalHeaders(cachedStamp);
+    if (HttpBody::canInflate()) {
+        reqHeaders["Accept-Encoding"] = "gzip, deflate";
+    }
+    if (DownloadConnections >= 2) {
+        // Request just the first part of the file. If the server supports
+        // ranges, the response tells us the size of the file.
+        reqHeaders["Range"] = "bytes=0-" + std::to_string(RangeBytes - 1);
+    }
+    boost::asio::ip::tcp::iostream data;
+    auto resp = HttpClient::setupDownload(hostName, path, data, port,
+                                          reqHeaders);
+    if (resp.status == 304) {
+        // Not modified. Use the cached copy without downloading it.
+        data.close();
+        if (TableSnapshot::load(csv, cacheFile, cachedStamp)) {
+            return;
+        }
+        // The cached copy is unusable. Discard it and download the file.
+        std::error_code ec;
+        std::filesystem::remove(cacheFile, ec);
+        loadFromURL(table, hostName, port, path, cacheFile);
+        return;
+    }
+    if (resp.status == 206 && !resp.header("content-encoding").empty()) {
+        // The server compressed the range. Compressed ranges cannot be
+        // parsed independently. So request the whole file instead.
+        data.close();
+        reqHeaders.erase("Range");
+        resp = HttpClient::setupDownload(hostName, path, data, port,
+                                         reqHeaders);
+    }
+    long start, end, total;
+    if (resp.status == 206 && HttpClient::parseContentRange(
+            resp.header("content-range"), start, end, total)) {
+        loadInRanges(csv, hostName, port, path,
+                     HttpClient::readBody(data, resp), total,
+                     resp.header("etag"));
+    } else {
+        // The server sent the whole file, possibly compressed. Read and
+        // decode the data on a separate thread while the data decoded so
+        // far is parsed on this thread.
+        HttpBody body(data, resp);
+        PipelinedInput pipe(body);
+        csv.load(pipe);
+        pipe.finish();
+    }
+    // Cache the data for revalidation if the server sent a validator
+    const std::string stamp = HttpClient::validator(resp);
+    if (!cacheFile.empty() && !stamp.empty()) {
+        try {
+            std::filesystem::create_directories(cacheDir);
+            // The table is not yet visible to other threads
+            table.adopt();
+            TableSnapshot::save(TableVersion::freeze(table), cacheFile, stamp);
+        } catch (const std::exception& exp) {
+            std::cerr << "Unable to cache " + path + ": " + exp.what() + "\n";
+        }
+    }
+}
+
+// Download the rest of a file in parallel ranges and parse them in parallel
+void SQLAir::loadInRanges(CSV& csv, const std::string& hostName,
+                          const std::string& port, const std::string& path,
+                          std::string&& first, const long total,
+                          const std::string& etag) {
+    // Split the rest of the file into one range per connection
+    const long start = first.size(), rest = total - start;
+    const long numRanges = std::min<long>(DownloadConnections,
+                                          (rest + RangeBytes - 1) / RangeBytes);
+    std::vector<std::string> chunks(numRanges + 1);
+    chunks[0] = std::move(first);
+    std::vector<std::exception_ptr> errors(numRanges + 1);
+    std::vector<std::thread> threads;
+    for (long i = 0; (i < numRanges); i++) {
+        threads.emplace_back(AllocTracker::wrap([&, i] {
+            try {
+                chunks[i + 1] = HttpClient::downloadRange(hostName, port, path,
+                    start + rest * i / numRanges,
+                    start + rest * (i + 1) / numRanges - 1, etag);
+            } catch (...) {
+                errors[i + 1] = std::current_exception();
+            }
+        }));
     }
+    for (auto& thr : threads) {
+        thr.join();
+    }
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+    ChunkParser::load(csv, chunks);
+}
+
+// Obtain a table from the catalog, loading it if needed
+PinnedTable SQLAir::loadTable(const std::string& fileOrURL) {
+    // Obtain the CSV from the catalog. If it is not in memory, only the
+    // first thread requesting it loads it (outside any critical section)
+    // while other threads requesting the same CSV wait for it.
+    return inMemoryCSV.get(fileOrURL, [&](TableEntry& table) {
+        CSV& csv = table.csv;
+        // Unsaved changes from before a crash take precedence over the file
+        const long redoGeneration = loadCheckpoint(csv, fileOrURL);
+        TableOptions options;
+        tableOptions.find(fileOrURL, options);
+        if (fileOrURL.find("http://") == 0) {
+            // This is an URL. We have to get the stream from a web-server
+            if (redoGeneration < 0) {
+                std::string host, port, path;
+                std::tie(host, port, path) = Helper::breakDownURL(fileOrURL);
+                loadFromURL(table, host, port, path,
+                            snapshotPath(fileOrURL));
+            }
+        } else {
+            long size = -1;
+            // Read-only tables are never changed, not even to load columns
+            if (redoGeneration < 0 && options.lazy && !options.readOnly) {
+                // Index the rows now and load each column on first use
+                size = LazyColumns::load(table, fileOrURL);
+            } else if (redoGeneration >= 0 ||
+                TableSnapshot::load(csv, snapshotPath(fileOrURL),
+                                    TableSnapshot::sourceStamp(fileOrURL))) {
+                size = std::filesystem::file_size(fileOrURL);
+            } else {
+                // We assume it is a local file on the server. Load that file
+                // with several large reads in flight while parsing.
+                AsyncFileReader data(fileOrURL);
+                // This method may throw exceptions on errors.
+                csv.load(data);
+                size = data.position();
+            }
+            // Track changes to the file to keep the table up to date
+            recordSource(table, fileOrURL, size);
+            if (watchFiles) {
+                watcher.watch(fileOrURL);
+            }
+        }
+        table.adopt();  // Move the loaded rows into the table's segments
+        recoverTable(table, fileOrURL, redoGeneration);
+        table.readOnly = options.readOnly;
+        partitionLoaded(table, options);
+    });
+}
+
+// Partition a freshly loaded table, if it was partitioned before
+void SQLAir::partitionLoaded(TableEntry& table, const TableOptions& options) {
+    const int keyColIdx = table.csv.getColumnIndex(options.partitionKey);
+    if (options.partitionKey.empty() || keyColIdx == -1) {
+        return;  // Not partitioned or the key column was removed
+    }
+    if (table.lazy != nullptr) {
+        table.lazy->materialize(table, {keyColIdx});
+    }
+    table.shards = ShardIndex::build(table, keyColIdx, options.numShards);
+}
+
+// Load the latest checkpoint of a table, if any
+long SQLAir::loadCheckpoint(CSV& csv, const std::string& fileOrURL) {
+    if (!checkpointing) {
+        return -1;
+    }
+    // The stamp of a checkpoint is the generation of the redo log that
+    // has the changes made after the checkpoint.
+    const std::string path = checkpointPath(fileOrURL);
+    const std::string stamp = TableSnapshot::readStamp(path);
+    std::istringstream is(stamp);
+    std::string word;
+    long generation = -1;
+    if (!(is >> word >> generation) || word != "redo" ||
+        !TableSnapshot::load(csv, path, stamp)) {
+        return -1;
+    }
+    return generation;
+}
+
+// Replay the redo log after a crash and attach it to the table
+void SQLAir::recoverTable(TableEntry& table, const std::string& fileOrURL,
+                          const long generation) {
+    if (!checkpointing) {
+        return;
+    }
+    // Without a checkpoint, the log has the changes made since the file
+    // was last saved. So all of it is replayed.
+    const std::string basePath = checkpointPath(fileOrURL);
+    if (table.lazy != nullptr && RedoLog::nextGeneration(basePath) > 0) {
+        // The changes are replayed on the values of all the columns
+        table.lazy->materialize(table, allColumns(table.csv));
+    }
+    const long numChanges =
+        RedoLog::replay(table, basePath, std::max(generation, 0L));
+    if (generation >= 0 || numChanges > 0) {
+        table.dirty = true;  // The recovered changes are not yet saved
+    }
+    table.redoLog = redoLogs.findOrInsert(fileOrURL, [&basePath] {
+        return std::make_shared<RedoLog>(basePath,
+                                         RedoLog::nextGeneration(basePath));
+    }).first;
+}
+
+// Checkpoint the tables updated since their last checkpoint
+void SQLAir::checkpointTables() {
+    for (const auto& [fileOrURL, redoLog] : redoLogs.snapshot()) {
+        const PinnedTable table = inMemoryCSV.find(fileOrURL);
+        if (redoLog->empty() || table == nullptr) {
+            continue;
+        }
+        ensureColumns(*table, table->csv.getColumnNames(), -1);
+        TableVersion version;
+        long generation;
+        {
+            // Updates are blocked while freezing. So the version has exactly
+            // the changes logged in the generations before the new one.
+            std::unique_lock<std::shared_mutex> tableLock(table->tableMutex);
+            if (!table->dirty) {
+                continue;  // Saved, and the log is discarded after the save
+            }
+            version = TableVersion::freeze(*table);
+            generation = redoLog->rotate();
+        }
+        std::filesystem::create_directories(cacheDir);
+        TableSnapshot::save(version, checkpointPath(fileOrURL),
+                            "redo " + std::to_string(generation), true);
+        // The older generations are included in the durable checkpoint
+        redoLog->removeBefore(generation);
+    }
+}
+
+// Remove the checkpoint and redo log of a table that has been saved
+void SQLAir::discardCheckpoint(TableEntry& table,
+                               const std::string& fileOrURL) {
+    if (table.redoLog == nullptr) {
+        return;
+    }
+    // Block updates so that none is logged between the check and removal
+    std::unique_lock<std::shared_mutex> tableLock(table.tableMutex);
+    if (table.dirty) {
+        return;  // Updated after the copy was saved. Keep the log.
+    }
+    // The checkpoint is removed first. If the server crashes before the
+    // log is removed, replaying the log on the saved file is harmless.
+    std::error_code ec;
+    std::filesystem::remove(checkpointPath(fileOrURL), ec);
+    table.redoLog->discard();
 }
 
 CSV& SQLAir::loadAndGet(std::string fileOrURL) {
-    // Check if the specified fileOrURL is already loaded in a thread-safe
-    // manner to avoid race conditions on the unordered_map
+    if (streamQuery) {
+        // A streamed file is neither loaded nor used as the recent CSV
+        if (fileOrURL.empty() || fileOrURL.find("http://") == 0) {
+            throw Exp("Only local files can be streamed");
+        }
+        streamScan = std::make_unique<StreamScan>(fileOrURL);
+        return streamScan->header;
+    }
+    // Update the most recently used CSV of this client's session
     {
-        std::scoped_lock<std::mutex> guard(recentCSVMutex);
+        Session& session = currentSession();
+        std::scoped_lock<std::mutex> guard(session.recentCSVMutex);
         // Use recent CSV if parameter was empty string.
-        fileOrURL = (fileOrURL.empty() ? recentCSV : fileOrURL);
+        fileOrURL = (fileOrURL.empty() ? session.recentCSV : fileOrURL);
         // Update the most recently used CSV for the next round
-        recentCSV = fileOrURL;
-        if (inMemoryCSV.find(fileOrURL) != inMemoryCSV.end()) {
-            // Requested CSV is already in memory. Just return it.
-            return inMemoryCSV.at(fileOrURL);
-        }
-    }
-    // When control drops here, we need to load the CSV into memory.
-    // Loading or I/O is being done outside critical sections
-    CSV csv;  // Load data into this csv
-    if (fileOrURL.find("http://") == 0) {
-        // This is an URL. We have to get the stream from a web-server
-        // Implement this feature.
-        std::string host, port, path;
-        std::tie(host, port, path) = Helper::breakDownURL(fileOrURL);
-        boost::asio::ip::tcp::iostream data;
-        setupDownload(host, path, data, port);
-        csv.load(data);
+        session.recentCSV = fileOrURL;
+    }
+    const PinnedTable table = loadTable(fileOrURL);
+    // Keep the table pinned in memory until the query finishes. So the
+    // reference remains valid.
+    queryTables.push_back(table);
+    return table->csv;
+}
+
+// Find the entry of a table returned by loadAndGet for the current query
+TableEntry& SQLAir::tableOf(const CSV& csv) {
+    for (const auto& table : queryTables) {
+        if (&table->csv == &csv) {
+            return *table;
+        }
+    }
+    throw Exp("The CSV is not used by the current query");
+}
+
+// Load several tables concurrently, reporting the time for each one
+bool SQLAir::preload(const StrVec& tables, std::ostream& os) {
+    // The result (time or error message) of loading each table
+    std::vector<std::string> results(tables.size());
+    std::atomic<size_t> next = {0};
+    std::atomic<bool> allLoaded = {true};
+    // Each worker thread loads the next table in the list until all the
+    // tables have been loaded. Loading is single-flight. So listing the
+    // same table twice does not load it twice.
+    auto worker = [&]() {
+        for (size_t i = next++; (i < tables.size()); i = next++) {
+            const auto startTime = std::chrono::steady_clock::now();
+            try {
+                loadTable(tables[i]);
+                const std::chrono::duration<double, std::milli> elapsed =
+                    std::chrono::steady_clock::now() - startTime;
+                std::ostringstream msg;
+                msg << "Loaded " << tables[i] << " in " << elapsed.count()
+                    << " ms";
+                results[i] = msg.str();
+            } catch (const std::exception& exp) {
+                results[i] = "Error loading " + tables[i] + ": " + exp.what();
+                allLoaded = false;
+            }
+        }
+    };
+    const size_t numThreads = std::min<size_t>(tables.size(),
+        std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::thread> pool;
+    for (size_t i = 0; (i < numThreads); i++) {
+        pool.emplace_back(AllocTracker::wrap(worker));
+    }
+    for (auto& thr : pool) {
+        thr.join();
+    }
+    // Report results in the order in which the tables were listed
+    for (const auto& result : results) {
+        os << result << std::endl;
+    }
+    return allLoaded;
+}
+
+// Process a "use" statement with one or more tables
+void SQLAir::validateAndProcessUse(const StrVec& sql, bool mustWait,
+                                   std::ostream& os) {
+    StrVec tables;
+    bool lazy = false, readOnly = false;
+    std::string partitionKey;
+    size_t numShards = std::max<size_t>(shardExecutor->size(), 1);
+    for (size_t i = 1; (i < sql.size()); i++) {
+        if (sql[i] == "lazy") {
+            lazy = true;
+        } else if (sql[i] == "readonly") {
+            readOnly = true;
+        } else if (sql[i] == "partition") {
+            // partition by <column>
+            if (i + 2 >= sql.size() || sql[i + 1] != "by") {
+                throw Exp("Expected partition by <column>");
+            }
+            partitionKey = sql[i += 2];
+        } else if (sql[i] == "shards") {
+            // shards <number>. The number is parsed as signed so that
+            // negative values are rejected rather than wrapped around.
+            char* end = nullptr;
+            const long num = (i + 1 < sql.size()) ?
+                std::strtol(sql[++i].c_str(), &end, 10) : 0;
+            if (end == nullptr || *end != '\0' || num < 1 || num > MaxShards) {
+                throw Exp("Expected shards <number> between 1 and " +
+                          std::to_string(MaxShards));
+            }
+            numShards = static_cast<size_t>(num);
+        } else if (!sql[i].empty() && sql[i] != ",") {
+            tables.push_back(sql[i]);
+        }
+    }
+    // Record the options so that they also apply when a table is reloaded
+    // (e.g., after it was evicted).
+    for (const auto& table : tables) {
+        TableOptions options;
+        tableOptions.find(table, options);
+        options.lazy = options.lazy || lazy;
+        options.readOnly = options.readOnly || readOnly;
+        tableOptions.set(table, options);
+    }
+    if (tables.size() < 2) {
+        StrVec useSql = {sql[0]};
+        useSql.insert(useSql.end(), tables.begin(), tables.end());
+        SQLAirBase::validateAndProcessUse(useSql, mustWait, os);
     } else {
-        // We assume it is a local file on the server. Load that file.
-        std::ifstream data(fileOrURL);
-        // This method may throw exceptions on errors.
-        csv.load(data);
+        preload(tables, os);
+        // Like a series of use statements, the last table becomes the default
+        loadAndGet(tables.back());
     }
+    // Tables that were already loaded are frozen now
+    for (size_t i = 0; readOnly && (i < tables.size()); i++) {
+        if (const PinnedTable table = inMemoryCSV.find(tables[i]);
+            table != nullptr) {
+            freezeTable(*table);
+        }
+    }
+    // Partition the tables and record the key so that reloaded tables are
+    // partitioned too.
+    for (size_t i = 0; !partitionKey.empty() && (i < tables.size()); i++) {
+        if (const PinnedTable table = inMemoryCSV.find(tables[i]);
+            table != nullptr) {
+            partitionTable(*table, partitionKey, numShards);
+            TableOptions options;
+            tableOptions.find(tables[i], options);
+            options.partitionKey = partitionKey;
+            options.numShards = numShards;
+            tableOptions.set(tables[i], options);
+        }
+    }
+}
 
-    // We get to this line of code only if the above if-else to load the
-    // CSV did not throw any exceptions. In this case we have a valid CSV
-    // to add to our inMemoryCSV list. We need to do that in a thread-safe
-    // manner.
-    std::scoped_lock<std::mutex> guard(recentCSVMutex);
-    // Move (instead of copy) the CSV data into our in-memory CSVs
-    inMemoryCSV[fileOrURL].move(csv);
-    // Return a reference to the in-memory CSV (not temporary one)
-    return inMemoryCSV.at(fileOrURL);
+// Partition the rows of a table on a key column
+void SQLAir::partitionTable(TableEntry& table, const std::string& keyColName,
+                            const size_t numShards) {
+    const int keyColIdx = table.csv.getColumnIndex(keyColName);
+    if (keyColIdx == -1) {
+        throw Exp("Column " + keyColName + " not found in CSV");
+    }
+    ensureColumns(table, {keyColName}, -1);
+    // Wait for in-flight queries so that the shards are consistent
+    std::unique_lock<std::shared_mutex> tableLock(table.tableMutex);
+    table.shards = ShardIndex::build(table, keyColIdx, numShards);
+}
+
+// Make a table immutable so that it can be read without any locks
+void SQLAir::freezeTable(TableEntry& table) {
+    if (table.readOnly) {
+        return;
+    }
+    ensureColumns(table, table.csv.getColumnNames(), -1);
+    // Wait for in-flight queries. Later updates see the flag and fail.
+    std::unique_lock<std::shared_mutex> tableLock(table.tableMutex);
+    table.readOnly = true;
 }
 
 // Save the currently loaded CSV file to a local file.
 void SQLAir::saveQuery(std::ostream& os) {
-    if (recentCSV.empty() || recentCSV.find("http://") == 0) {
-        throw Exp("Saving CSV to an URL using POST is not implemented");
+    std::string fileName;
+    const long job = startSave(fileName);
+    os << fileName << " is being saved (job " << job << ").\n";
+}
+
+// Process a save statement, waiting for the save to finish if requested
+void SQLAir::validateAndProcessSave(const StrVec& sql, bool mustWait,
+                                    std::ostream& os) {
+    if (!mustWait) {
+        SQLAirBase::validateAndProcessSave(sql, mustWait, os);
+        return;
+    }
+    // "wait save" blocks until the data has been written
+    if (sql.size() > 1) {
+        loadAndGet(sql[1]);
+    }
+    std::string fileName;
+    saveJobs.wait(startSave(fileName));
+    os << fileName << " saved.\n";
+}
+
+// Freeze the recent CSV and queue a job to write the frozen version
+long SQLAir::startSave(std::string& fileName) {
+    {
+        Session& session = currentSession();
+        std::scoped_lock<std::mutex> guard(session.recentCSVMutex);
+        fileName = session.recentCSV;
+    }
+    const PinnedTable table = inMemoryCSV.find(fileName);
+    if (table == nullptr) {
+        throw Exp(fileName.empty() ? "No CSV to save" :
+                  fileName + " is not loaded");
+    }
+    ensureColumns(*table, table->csv.getColumnNames(), -1);
+    // Freeze a consistent version of the rows. No rows are copied here, as
+    // the table copies a shared segment before changing it. Updates made
+    // after this point mark the CSV dirty again.
+    TableVersion version;
+    {
+        std::unique_lock<std::shared_mutex> tableLock(table->tableMutex);
+        table->dirty = false;
+        version = TableVersion::freeze(*table);
+    }
+    // Write the version in the background while queries continue to use
+    // and change the CSV.
+    return saveJobs.submit([this, table, version, fileName] {
+        try {
+            if (fileName.find("http://") == 0) {
+                saveToURL(version, fileName);
+                // The cached copy no longer matches the version on the server
+                std::error_code ec;
+                std::filesystem::remove(snapshotPath(fileName), ec);
+            } else {
+                saveToFile(*table, version, fileName);
+            }
+            discardCheckpoint(*table, fileName);
+        } catch (...) {
+            table->dirty = true;  // The changes were not saved
+            throw;
+        }
+    });
+}
+
+// Durably replace a local file with the contents of a CSV
+void SQLAir::saveToFile(TableEntry& table, const TableVersion& version,
+                        const std::string& fileName) {
+    // The data is written to a temporary file that then replaces the file
+    // so that the watcher (and other processes) never see a partially
+    // written file, even if the server crashes.
+    const std::string tmpName = fileName + ".tmp";
+    AsyncFileWriter csvData(tmpName);
+    CsvWriter::save(version, csvData, ",", true, "\n", SaveThreads);
+    csvData.close();
+    syncFile(tmpName);
+    // Record the saved file so that the watcher does not reload it. The
+    // size and modification time are not changed by renaming.
+    recordSource(table, tmpName, std::filesystem::file_size(tmpName));
+    std::filesystem::rename(tmpName, fileName);
+    // Make the rename durable as well
+    const std::filesystem::path dir =
+        std::filesystem::path(fileName).parent_path();
+    syncFile(dir.empty() ? "." : dir.string());
+}
+
+// Save a table to a web-server via a streaming, chunked PUT (or POST)
+void SQLAir::saveToURL(const TableVersion& version, const std::string& url) {
+    std::string host, port, path;
+    std::tie(host, port, path) = Helper::breakDownURL(url);
+    const char* method = std::getenv("SQLAIR_SAVE_METHOD");
+    const bool compress = (getEnvLong("SQLAIR_SAVE_GZIP", 0) != 0);
+    HttpHeaders reqHeaders = {{"Content-Type", "text/csv"},
+                              {"Transfer-Encoding", "chunked"}};
+    if (compress) {
+        reqHeaders["Content-Encoding"] = "gzip";
+    }
+    boost::asio::ip::tcp::iostream data;
+    HttpClient::sendRequest((method != nullptr ? method : "PUT"), host, path,
+                            data, port, reqHeaders);
+    // The CSV is sent in chunks as it is formatted
+    HttpUpload body(data, compress);
+    CsvWriter::save(version, body, ",", true, "\n", SaveThreads);
+    body.finish();
+    HttpClient::readResponse(data, "saving " + path + " to " + host +
+                             " at port " + port, false);
+}
+
+// Reload a table (in the background) whose file was changed
+void SQLAir::reloadTable(const std::string& path) try {
+    const PinnedTable table = inMemoryCSV.find(path);
+    if (table == nullptr) {
+        return;  // Evicted. Its snapshot is stale and will not be used.
+    }
+    std::error_code ec;
+    const long size = std::filesystem::file_size(path, ec);
+    const auto mtime = std::filesystem::last_write_time(path, ec);
+    if (ec || (size == table->sourceSize &&
+               mtime.time_since_epoch().count() == table->sourceMTime)) {
+        return;  // The file is missing or unchanged (e.g., saved by us)
+    }
+    // Rows changed after this point are not in the file loaded below
+    const long changes = table->changes;
+    if (table->dirty) {
+        std::cerr << "Not reloading " + path + " as it has unsaved changes\n";
+        return;
+    }
+    // Check if the file was only appended to. Rows are never appended to
+    // read-only tables, as they are read without any locks.
+    if (!table->readOnly && size > table->sourceSize &&
+        fingerprint(path, table->sourceSize) == table->sourceFingerprint) {
+        if (appendRows(*table, path) > 0) {
+            table->csv.csvCondVar.notify_all();  // Wake-up waiting queries
+            return;
+        }
+        if (!table->readOnly) {
+            return;  // No complete lines were appended yet
+        }
+        // The table was made read-only meanwhile. So reload it fully.
+    }
+    // The file was rewritten. Load it fully and swap it in atomically.
+    TablePtr fresh = std::make_shared<TableEntry>();
+    TableOptions options;
+    tableOptions.find(path, options);
+    if (options.lazy && !options.readOnly) {
+        recordSource(*fresh, path, LazyColumns::load(*fresh, path));
+    } else {
+        AsyncFileReader data(path);
+        fresh->csv.load(data);
+        recordSource(*fresh, path, data.position());
+    }
+    fresh->adopt();
+    fresh->redoLog = table->redoLog;
+    fresh->readOnly = options.readOnly;
+    partitionLoaded(*fresh, options);
+    {
+        // Block updates while checking for changes since the file was
+        // checked. Changes that were saved meanwhile are no longer dirty
+        // but would still be lost, as the saved file was not loaded.
+        std::unique_lock<std::shared_mutex> tableLock(table->tableMutex);
+        if (table->dirty || table->changes != changes) {
+            std::cerr << "Not reloading " + path + " as it was changed\n";
+            return;
+        }
+        inMemoryCSV.replace(path, fresh);
+    }
+    table->csv.csvCondVar.notify_all();
+} catch (const std::exception& exp) {
+    std::cerr << "Error reloading " + path + ": " + exp.what() + "\n";
+}
+
+// Load rows appended to a file and append them to the table
+size_t SQLAir::appendRows(TableEntry& table, const std::string& path) {
+    CSV& csv = table.csv;
+    std::ifstream file(path, std::ios::binary);
+    const long start = table.sourceSize;
+    if (!file.seekg(start)) {
+        return 0;
+    }
+    std::string tail((std::istreambuf_iterator<char>(file)),
+                     std::istreambuf_iterator<char>());
+    // Only load complete lines. Partial lines are loaded on a later change.
+    tail.resize(tail.rfind('\n') + 1);
+    if (tail.empty()) {
+        return 0;
+    }
+    // Use the standard loader by prefixing the header to the new rows
+    std::string header;
+    for (const auto& colName : csv.getColumnNames()) {
+        header += (header.empty() ? "\"" : ",\"") + colName + "\"";
+    }
+    std::istringstream data(header + "\n" + tail);
+    CSV rows;
+    rows.load(data);
+    {
+        // Appending may add segments. So block all other queries.
+        std::unique_lock<std::shared_mutex> tableLock(table.tableMutex);
+        if (table.readOnly) {
+            return 0;  // Made read-only (see freezeTable) since the check
+        }
+        const size_t fromRow = table.size();
+        table.memoryUsage += table.append(rows);
+        table.changes++;
+        if (table.shards != nullptr) {
+            table.shards->add(table, fromRow);
+        }
+        // The cached numeric columns are rebuilt on next use
+        table.numericShadow.clear();
+        recordSource(table, path, start + tail.size());
     }
-    // Create a local file and have the CSV write itself.
-    std::ofstream csvData(recentCSV);
-    inMemoryCSV.at(recentCSV).save(csvData);
-    os << recentCSV << " saved.\n";
+    return rows.size();
 }
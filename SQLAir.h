@@ -15,10 +15,22 @@
 #include <iostream>
 #include <tuple>
 #include <memory>
+#include <memory_resource>
+#include <vector>
 #include <thread>
 #include <atomic>
 #include <condition_variable>
 #include "SQLAirBase.h"
+#include "AsyncFile.h"
+#include "FileWatcher.h"
+#include "RedoLog.h"
+#include "SaveJobs.h"
+#include "ShardExecutor.h"
+#include "TableCatalog.h"
+#include "TableVersion.h"
+
+// Forward declaration to avoid including the header in all sources
+class ResultWriter;
 
 // Shortcut to smart pointer with TcpStream
 using TcpStreamPtr = std::shared_ptr<boost::asio::ip::tcp::iostream>;
@@ -30,6 +42,58 @@ using TcpStreamPtr = std::shared_ptr<boost::asio::ip::tcp::iostream>;
  */
 class SQLAir : public SQLAirBase {
 public:
+    /**
+     * The constructor configures the catalog of tables using the following
+     * environment variables:
+     *
+     *   - SQLAIR_MEMORY_BUDGET_MB: The memory budget (in MB) for the tables
+     *     loaded in memory. If the budget is exceeded, the least recently
+     *     used tables that have no unsaved changes are evicted. By default
+     *     (or if the value is zero), tables are never evicted.
+     *   - SQLAIR_CACHE_DIR: Directory where binary snapshots of evicted
+     *     tables are written so that they can be quickly reloaded. The
+     *     default is "sqlair-cache" in the system's temporary directory.
+     *   - SQLAIR_WATCH_FILES: If this is set to 0, local files are not
+     *     watched for changes. By default, tables whose files are changed
+     *     by other processes are reloaded in the background (see
+     *     reloadTable()).
+     *   - SQLAIR_CHECKPOINT_SECS: If this is set to a positive value,
+     *     updates are recorded in a redo log (see RedoLog) and tables with
+     *     unsaved changes are checkpointed (to SQLAIR_CACHE_DIR) in the
+     *     background at this interval. Unsaved changes are recovered when
+     *     a table is loaded after a crash (see recoverTable()). By default
+     *     checkpointing is disabled.
+     */
+    SQLAir();
+
+    /**
+     * Top-level method to process a SQL-air query. This method overrides
+     * the base class method to measure each query. The actual processing
+     * is delegated to the base class. In addition, this method handles the
+     * following:
+     *
+     *   1. If the query is prefixed with "explain analyze", the prefix is
+     *      removed and the time and allocations (see AllocTracker) for the
+     *      query are printed after the query's results. The allocations
+     *      include those made by the threads working for the query.
+     *   2. If the query took longer than the slow-query threshold (set via
+     *      the SQLAIR_SLOW_QUERY_MS environment variable), the query along
+     *      with its time and allocations is logged to std::cerr.
+     *   3. Tables used by the query remain pinned in memory (i.e., they
+     *      are not evicted) until the query finishes.
+     *   4. A select prefixed with "stream" scans the file in a single pass
+     *      without loading it into memory (see preprocess()).
+     *
+     * @param sql The SQL-air query to be processed by this method.
+     *
+     * @param os The output stream to where results from the processing are
+     * to be written.
+     *
+     * @return This method returns true if further queries are to be processed.
+     * This method returns false if the command was "exit;"
+     */
+    bool process(const std::string& sql, std::ostream& os) override;
+
     /**
      * Method to perform the actual operations associated with printing a
      * given set of columns in a given CSV that match an optional condition.
@@ -197,9 +261,15 @@ public:
     
     /**
      * Saves the recently used CSV using the name specified in the recentCSV
-     * string. If the recent CSV was downloaded from an URL, then this method
-     * throws an exception (as this feature is not yet implemented). If the CSV
-     * was loaded from a a file, then the data in the file is overwritten.
+     * string of the current session. If the recent CSV was downloaded from
+     * an URL, then the CSV is sent to the web-server via a HTTP PUT request
+     * (see saveToURL()). If the CSV was loaded from a a file, then the data
+     * in the file is overwritten (see saveToFile()).
+     *
+     * @note The CSV is written in the background from a version of the
+     * table (see startSave()). This method returns immediately and prints the
+     * job number of the save. Use "wait save" to wait for the save to
+     * finish.
      * 
      * @param os The output stream to where the result of saving (if any) is
      * to be written.
@@ -210,11 +280,16 @@ public:
     
     /**
      * Helper method to obtain a reference to a pre-loaded CSV file from the
-     * inMemoryCSV map.  If the requested file is not present, then this
-     * method loads the data into the inMemoryCSV.   
-     * 
-     * @note Currently, this method is not MT-safe. So avoid calling this 
-     * method from multiple threads simultaneously.
+     * inMemoryCSV catalog.  If the requested file is not present, then this
+     * method loads the data into the inMemoryCSV.
+     *
+     * @note This method is MT-safe. If several threads request the same
+     * CSV that is not yet loaded, only one of them loads it and the others
+     * wait for it to be loaded.
+     *
+     * @note The CSV is pinned in memory until the query that called this
+     * method finishes (see process()). A local file is loaded from its
+     * binary snapshot if the file was not changed since it was evicted.
      * 
      * @param fileOrURL Path to a CSV file or a URL to a CSV data to be returned
      * by this method.  If the path is empty string, then this method returns
@@ -241,12 +316,106 @@ public:
      * @param server The BOOST acceptor that must be used to accept connections
      * from clients.
      * 
+     * @note Before accepting connections, the tables listed (separated by
+     * commas) in the SQLAIR_PRELOAD environment variable are loaded in
+     * parallel via the preload() method.
+     *
      * @param maxThr An optional maximum number of threads to be used by this
      * method.
      */
     void runServer(boost::asio::ip::tcp::acceptor& server, const int maxThr);
 
+    /**
+     * Load several tables concurrently using a pool of threads. The time
+     * taken is bounded by the largest table rather than the sum of the
+     * times of all the tables. For each table, a line of the form
+     * "Loaded test.csv in 1.5 ms" (or an error message) is printed.
+     *
+     * @param tables The paths or URLs of the tables to be loaded.
+     *
+     * @param os The output stream to where the load times are written.
+     *
+     * @return This method returns true if all the tables were loaded.
+     */
+    bool preload(const StrVec& tables, std::ostream& os);
+
 protected:
+    /**
+     * Processes a "use" statement. This method overrides the base class
+     * method to permit loading several tables (in parallel) in a single
+     * statement, for example:
+     *
+     *     use test.csv, movies_db_20.csv, airports.csv;
+     *
+     * The last table becomes the most recently used CSV. A statement with a
+     * single table behaves the same as in the base class. The optional
+     * "lazy" keyword loads local files lazily (see LazyColumns), i.e., a
+     * column is read from the file only when a query first uses it:
+     *
+     *     use huge.csv lazy;
+     *
+     * A lazily loaded file is memory mapped. So it must not be truncated
+     * in place while the table has columns that are yet to be loaded.
+     *
+     * The optional "readonly" keyword makes the tables immutable (see
+     * freezeTable()), e.g., for reference data that is never updated:
+     *
+     *     use airports.csv readonly;
+     *
+     * The optional "partition by" clause splits the rows of the tables into
+     * shards by the hash of a key column (see ShardIndex), optionally with
+     * the number of shards (by default, SQLAIR_SHARD_WORKERS):
+     *
+     *     use flights.csv partition by iata shards 8;
+     *
+     * @param sql The tokens in the use statement to be processed.
+     *
+     * @param mustWait This flag is not applicable for this query and is
+     * ignored.
+     *
+     * @param os The output stream to where the results are to be written.
+     */
+    void validateAndProcessUse(const StrVec& sql, bool mustWait,
+                               std::ostream& os) override;
+
+    /**
+     * Processes a "save" statement. This method overrides the base class
+     * method so that "wait save" waits for the background save to finish
+     * and reports any errors. A plain "save" is processed by the base class
+     * (which calls saveQuery()).
+     *
+     * @param sql The tokens in the save statement to be processed.
+     *
+     * @param mustWait If this flag is true, this method returns only after
+     * the CSV has been written.
+     *
+     * @param os The output stream to where the results are to be written.
+     */
+    void validateAndProcessSave(const StrVec& sql, bool mustWait,
+                                std::ostream& os) override;
+
+    /**
+     * Breaks a query into tokens. This method overrides the base class
+     * method to handle an optional "stream" prefix, for example:
+     *
+     *     stream select * from huge.csv where year = 2015;
+     *
+     * A streamed select parses and filters a local file in blocks of rows
+     * and prints the matching rows as they are found. The file is never
+     * loaded into the catalog. Hence files larger than the memory can be
+     * queried, but each query reads the whole file.
+     *
+     * @param sql The query to be tokenized.
+     *
+     * @return The tokens, the wait flag, and the command (see the base
+     * class) of the query without the "stream" prefix.
+     *
+     * @exception Exp This method throws an exception if a query other than
+     * a select (or a "wait select") is prefixed with "stream".
+     */
+    std::tuple<StrVec, bool, int>
+        preprocess(const std::string& sql) const override;
+
     /**
      * This method is a refactored utility method. This method is called from
      * the seqlectQuery method. This method performs the actual operations
@@ -337,9 +506,196 @@ protected:
      * @return This method returns the number of rows updated by this method.
      */
     int tryUpdate(CSV& csv, bool mustWait, StrVec colNames,
-        StrVec values, const int whereColIdx, const std::string& cond, 
+        StrVec values, const int whereColIdx, const std::string& cond,
         const std::string& value);
-    
+
+    /**
+     * The information in a where clause prepared once per query to
+     * streamline checking each row of the CSV. If the value in the where
+     * clause is a number, then the numeric shadow of the column (see the
+     * NumericShadow class) is used to compare numbers without parsing the
+     * string in each row.
+     */
+    struct WhereClause {
+        /** The index of the column in the where clause or -1 if none */
+        int colIdx = -1;
+        /** The condition in the where clause, e.g., "=" or "like" */
+        const std::string* cond = nullptr;
+        /** The value specified by the user in the where clause */
+        const std::string* value = nullptr;
+        /** The numeric value of value, if shadow is not nullptr */
+        double numValue = 0;
+        /** The numeric values of the column, if a numeric comparison */
+        const std::vector<double>* shadow = nullptr;
+    };
+
+    /**
+     * Prepares the where clause of a query for use with rowMatches(). This
+     * method is called once at the beginning of each query.
+     *
+     * @param table The table on which the query operates.
+     *
+     * @param whereColIdx The index of the column in the where clause or -1
+     * if the query does not have a where clause.
+     *
+     * @param cond The condition in the where clause.
+     *
+     * @param value The value in the where clause.
+     *
+     * @return The prepared where clause. The returned object refers to cond
+     * and value and must not outlive them.
+     */
+    WhereClause prepareWhere(TableEntry& table, const int whereColIdx,
+        const std::string& cond, const std::string& value);
+
+    /**
+     * Checks if a row in a CSV satisfies a prepared where clause. This
+     * method must be called only while holding the row's rowMutex.
+     *
+     * @param row The row to be checked.
+     *
+     * @param rowIdx The zero-based index of the row in the CSV. This is
+     * used to look-up the numeric shadow of the row's value.
+     *
+     * @param where The prepared where clause.
+     *
+     * @return This method returns true if the row satisfies the where
+     * clause (or if there is no where clause).
+     */
+    bool rowMatches(const PackedRow& row, const size_t rowIdx,
+        const WhereClause& where) const;
+
+    /**
+     * Run a select query once (see selectQuery()). A "wait select" calls
+     * this method again, in a fresh arena, each time it is woken up.
+     *
+     * @param csv The table whose rows are to be printed.
+     *
+     * @param colNames The names of the columns to be printed.
+     *
+     * @param whereColIdx The index of the column in the where clause or -1
+     * if the query does not have a where clause.
+     *
+     * @param cond The condition in the where clause.
+     *
+     * @param value The value in the where clause.
+     *
+     * @param writer The writer to which the matching rows are printed.
+     *
+     * @return The number of rows printed.
+     */
+    int selectAttempt(CSV& csv, const StrVec& colNames,
+                      const int whereColIdx, const std::string& cond,
+                      const std::string& value, ResultWriter& writer);
+
+    /**
+     * Run an update query once (see updateQuery()). A "wait update" calls
+     * this method again, in a fresh arena, each time it is woken up.
+     *
+     * @param csv The table whose rows are to be updated.
+     *
+     * @param colNames The names of the columns to be updated.
+     *
+     * @param values The new values for the columns.
+     *
+     * @param whereColIdx The index of the column in the where clause or -1
+     * if the query does not have a where clause.
+     *
+     * @param cond The condition in the where clause.
+     *
+     * @param value The value in the where clause.
+     *
+     * @return The number of rows updated.
+     */
+    int updateAttempt(CSV& csv, const StrVec& colNames, const StrVec& values,
+                      const int whereColIdx, const std::string& cond,
+                      const std::string& value);
+
+    /**
+     * Print the rows of a read-only table that match an optional condition.
+     * The rows are read in place without any locks (see freezeTable()).
+     *
+     * @param table The read-only table whose rows are to be printed.
+     *
+     * @param whereColIdx The index of the column in the where clause or -1
+     * if the query does not have a where clause.
+     *
+     * @param cond The condition in the where clause.
+     *
+     * @param value The value in the where clause.
+     *
+     * @param writer The writer to which the matching rows are printed.
+     *
+     * @return The number of rows printed.
+     */
+    int selectReadOnly(TableEntry& table, const int whereColIdx,
+                       const std::string& cond, const std::string& value,
+                       ResultWriter& writer);
+
+    /**
+     * The first pass of a select query: find the rows that match the where
+     * clause. Only the where column of each row is read (the other columns
+     * are gathered later, only for the matching rows, by selectRows()).
+     * For a partitioned table, a "key = value" condition checks only one
+     * shard and other conditions check all the shards in parallel.
+     *
+     * @note The caller must hold the table's tableMutex (in shared mode).
+     *
+     * @param table The table whose rows are to be checked.
+     *
+     * @param where The prepared where clause (see prepareWhere()).
+     *
+     * @return The indexes of the matching rows, allocated in the query's
+     * arena. If the query does not have a where clause, then all the rows
+     * match and the returned list is empty.
+     */
+    std::pmr::vector<size_t> matchingRows(TableEntry& table,
+                                          const WhereClause& where);
+
+    /**
+     * The second pass of a select query: gather the selected columns of
+     * the rows found by matchingRows() and print them. Each row is checked
+     * again, as it may have been updated since the first pass.
+     *
+     * @note The caller must hold the table's tableMutex (in shared mode).
+     *
+     * @param table The table whose rows are to be printed.
+     *
+     * @param where The prepared where clause used to find the rows.
+     *
+     * @param rowIdxs The indexes of the rows returned by matchingRows().
+     *
+     * @param writer The writer to which the selected columns are printed.
+     *
+     * @return The number of rows printed.
+     */
+    int selectRows(TableEntry& table, const WhereClause& where,
+                   const std::pmr::vector<size_t>& rowIdxs,
+                   ResultWriter& writer);
+
+    /**
+     * Print the rows of a large table that match an optional condition.
+     * The rows are read from an immutable version of the table (see
+     * TableVersion) without holding any locks. Tables with at least
+     * SQLAIR_VERSIONED_SCAN_ROWS (default 50000) rows are selected this way.
+     *
+     * @param table The table whose rows are to be printed.
+     *
+     * @param whereColIdx The index of the column in the where clause or -1
+     * if the query does not have a where clause.
+     *
+     * @param cond The condition in the where clause.
+     *
+     * @param value The value in the where clause.
+     *
+     * @param writer The writer to which the matching rows are printed.
+     *
+     * @return The number of rows printed.
+     */
+    int selectVersion(TableEntry& table, const int whereColIdx,
+        const std::string& cond, const std::string& value,
+        ResultWriter& writer);
+
     /**
      * A thread-main method to process each request from a web-client in a
      * separate thread. This method is called from the runServer method
@@ -364,10 +720,27 @@ protected:
      * is broken down into host, port, and path by calling the 
      * Helper::breakdownURL() method.  However, the user
      * must continue to use the full URL for referencing the data. This method
-     * establishes the TCP stream and simply calls the csv.load() method to
-     * load the CSV data from the TCP stream.
+     * establishes the TCP stream and calls the csv.load() method to load the
+     * CSV data. The data is read from the TCP stream by a background thread
+     * (see PipelinedInput) so that downloading overlaps with parsing.
+     *
+     * If the server supports HTTP range requests and the file is larger
+     * than SQLAIR_RANGE_KB (default 1024), the file is downloaded via up to
+     * SQLAIR_DOWNLOAD_CONNECTIONS (default 4) concurrent range requests
+     * (see loadInRanges()).
+     *
+     * Chunked responses are decoded and, if SQLAir is compiled with
+     * -DSQLAIR_USE_ZLIB (and linked with -lz), compressed responses are
+     * requested and inflated while they are being parsed (see HttpBody).
+     *
+     * The downloaded data is cached on disk as a binary snapshot (see
+     * TableSnapshot) along with the ETag or Last-Modified header sent by
+     * the server. If a cached copy exists, the request is made conditional
+     * (via If-None-Match or If-Modified-Since) and the cached copy is used
+     * if the server responds with "304 Not Modified".
      * 
-     * @param csv The CSV object into which the data is to be loaded.
+     * @param table The table into whose CSV the data is to be loaded. It
+     * must not yet be visible to other threads.
      * 
      * @param hostName The server host name from where the data is to be 
      * retrieved. This would be "localhost" or "os1.csi.miamioh.edu"
@@ -377,35 +750,511 @@ protected:
      * 
      * @param path The path to the CSV file on the server. The path to the 
      * file on the server. This is of the form "/test.csv"
+     *
+     * @param cacheFile The path to the file where the data is cached. If
+     * this is an empty string, the data is not cached.
      * 
      * @exception Exp This method throws exceptions if errors ocurr when 
      * reading the data from the server.
      */
-    void loadFromURL(CSV& csv, const std::string& hostName, 
-        const std::string& port, const std::string& path);
+    void loadFromURL(TableEntry& table, const std::string& hostName, 
+        const std::string& port, const std::string& path,
+        const std::string& cacheFile = "");
+
+    /**
+     * Helper method to obtain a table from the inMemoryCSV catalog, loading
+     * it (from a local file, its snapshot, or a URL) if needed. Unlike
+     * loadAndGet(), this method neither changes the most recently used CSV
+     * nor keeps the table pinned once the returned pointer is released.
+     *
+     * @param fileOrURL Path to a CSV file or a URL to a CSV data.
+     *
+     * @return The table. This method never returns nullptr.
+     *
+     * @exception This method throws an exception if the table could not
+     * be loaded.
+     */
+    PinnedTable loadTable(const std::string& fileOrURL);
+
+    /**
+     * Helper method to download the rest of a remote CSV via several
+     * concurrent HTTP range requests and to parse the ranges in parallel
+     * (see ChunkParser). This method is called from loadFromURL() once the
+     * first range has been downloaded.
+     *
+     * @param csv The CSV object into which the data is to be loaded.
+     *
+     * @param hostName The server host name from where the data is to be
+     * retrieved.
+     *
+     * @param port The port number from where the data is to be retrieved.
+     *
+     * @param path The path to the CSV file on the server.
+     *
+     * @param first The first range of the file (starting at offset zero).
+     *
+     * @param total The size of the file on the server.
+     *
+     * @param etag The ETag of the file, if any. It ensures that all the
+     * ranges are from the same version of the file.
+     */
+    void loadInRanges(CSV& csv, const std::string& hostName,
+                      const std::string& port, const std::string& path,
+                      std::string&& first, const long total,
+                      const std::string& etag);
+
+    /**
+     * The information maintained for each client (session). Web-clients
+     * are identified by the X-SQLAir-Session header in their requests
+     * (sent by the web page, so each open page has its own session) or
+     * else by their address. Sessions of clients that have not sent a
+     * request for a while are discarded (see pruneSessions()).
+     */
+    struct Session {
+        /**
+         * The most recently referenced CSV in a query by this client. This
+         * value is updated in the loadAndGet method.
+         */
+        std::string recentCSV;
+
+        /**
+         * This is a convenience mutex that is used to enable thread-safe
+         * operations on the recentCSV instance variable. Since each client
+         * has its own session, this mutex is not shared by all requests.
+         */
+        std::mutex recentCSVMutex;
+
+        /**
+         * The time (in steady_clock ticks) of the latest request of the
+         * client. It is read and written with relaxed memory ordering.
+         */
+        std::atomic<long> lastUsed = {0};
+    };
+
+    /**
+     * Obtain the session associated with the request being processed by
+     * the calling thread.
+     *
+     * @return The session of the web-client or the console session.
+     */
+    Session& currentSession();
     
 private:
     /**
-     * The most recently referenced CSV in a query. This value is updated
-     * int he getOrLoadCSV method.
+     * The session used for queries that are not associated with a client,
+     * i.e., queries typed-in at the console.
      */
-    std::string recentCSV;
-    
+    Session consoleSession;
+
     /**
-     * This is a convenience mutex that is used to enable thread-safe 
-     * operations on the recentCSV instance variable in this class. This
-     * mutex is locked and unlocked in the loadAndGet method in this class.
+     * The sessions of web-clients, indexed by the value of the
+     * X-SQLAir-Session header or by the client's address (see
+     * clientThread()).
      */
-    std::mutex recentCSVMutex;
-    
+    ShardedMap<std::string, std::shared_ptr<Session>> sessions;
+
+    /** The time (in steady_clock ticks) sessions were last pruned */
+    std::atomic<long> lastPrune = {0};
+
+    /**
+     * Obtain the session of a web-client, creating it for a new client,
+     * and record the time of the client's request.
+     *
+     * @param clientID The value of the X-SQLAir-Session header of the
+     * request or the client's address.
+     *
+     * @return The session of the client.
+     */
+    std::shared_ptr<Session> findSession(const std::string& clientID);
+
+    /**
+     * Discard the sessions of web-clients that have not sent a request
+     * for SQLAIR_SESSION_IDLE_SECS seconds (default 1800) and that are not
+     * used by a request. Sessions are checked at most once every few
+     * seconds, by one of the threads that finished a request.
+     */
+    void pruneSessions();
+
+    /**
+     * The session of the client whose request is being processed by the
+     * calling thread. This is set in the clientThread method. If it is
+     * nullptr, then the consoleSession is used.
+     */
+    static thread_local Session* threadSession;
+
+    /**
+     * The tables used by the query being processed by the calling thread.
+     * Holding the pointers keeps the tables pinned in memory (see
+     * TableCatalog) until the query finishes.
+     */
+    static thread_local std::vector<PinnedTable> queryTables;
+
+    /**
+     * Obtain the entry of a table used by the query being processed by the
+     * calling thread, e.g., to access the locks of the CSV passed to
+     * selectQuery() by the base class.
+     *
+     * @param csv A CSV returned by loadAndGet() for the current query.
+     *
+     * @return The catalog entry that owns the CSV.
+     *
+     * @exception Exp This method throws an exception if the CSV is not
+     * used by the current query.
+     */
+    static TableEntry& tableOf(const CSV& csv);
+
+    /**
+     * The state of a streamed select (see preprocess()). The header-only
+     * CSV is returned by loadAndGet() so that the base class can validate
+     * the query, and selectQuery() then reads the rows from the input.
+     */
+    struct StreamScan {
+        /**
+         * Opens a local file and reads its header line.
+         *
+         * @param path The path to the file to be streamed.
+         *
+         * @exception Exp This method throws an exception if the file could
+         * not be opened.
+         */
+        explicit StreamScan(const std::string& path);
+
+        /** The file, positioned after the header line */
+        AsyncFileReader input;
+
+        /** A CSV with the column names of the file and no rows */
+        CSV header;
+    };
+
+    /**
+     * The command that SQLAirBase::preprocess() returns for select
+     * queries. Commands are numbered in the order "exit", "select",
+     * "update", "insert", "delete", "use", "save".
+     */
+    static constexpr int SelectCmd = 1;
+
+    /** Flag set by preprocess() if the calling thread's query is streamed */
+    static thread_local bool streamQuery;
+
+    /** The file being streamed by the calling thread's query, if any */
+    static thread_local std::unique_ptr<StreamScan> streamScan;
+
+    /**
+     * An RAII helper used by process() to clean up after a query, even if
+     * the query throws an exception. It unpins the tables used by the
+     * query (see queryTables) and closes the file streamed by the query,
+     * if any.
+     */
+    struct QueryCleanup {
+        /** Records the tables pinned before the query starts */
+        QueryCleanup();
+
+        /** Unpins the tables used by the query and ends any stream */
+        ~QueryCleanup();
+
+        /** The number of tables in queryTables before the query started */
+        const size_t numTables;
+    };
+
+    /**
+     * Print the rows of the file being streamed that match an optional
+     * condition. The rows are parsed in blocks of about StreamBlockBytes.
+     *
+     * @param colNames The names of the columns to be printed.
+     *
+     * @param whereColIdx The index of the column in the where clause or -1
+     * if the query does not have a where clause.
+     *
+     * @param cond The condition in the where clause.
+     *
+     * @param value The value in the where clause.
+     *
+     * @param os The output stream to where the results are to be written.
+     */
+    void streamSelect(const StrVec& colNames, const int whereColIdx,
+                      const std::string& cond, const std::string& value,
+                      std::ostream& os);
+
+    /**
+     * Obtain the path to the binary snapshot of a table.
+     *
+     * @param fileOrURL The path or URL from where the table was loaded.
+     *
+     * @return The path to the snapshot in the SQLAIR_CACHE_DIR directory.
+     */
+    std::string snapshotPath(const std::string& fileOrURL) const;
+
+    /** The directory where snapshots of evicted tables are stored */
+    std::string cacheDir;
+
+    /**
+     * Obtain the path to the checkpoint of a table. The files of the
+     * table's redo log use this path as the prefix.
+     *
+     * @param fileOrURL The path or URL from where the table was loaded.
+     *
+     * @return The path to the checkpoint in the SQLAIR_CACHE_DIR directory.
+     */
+    std::string checkpointPath(const std::string& fileOrURL) const;
+
+    /**
+     * Load the latest checkpoint of a table, if checkpointing is enabled
+     * and a checkpoint exists.
+     *
+     * @param csv The empty CSV into which the checkpoint is to be loaded.
+     *
+     * @param fileOrURL The path or URL identifying the table.
+     *
+     * @return The generation of the redo log that follows the checkpoint
+     * or -1 if the table was not loaded from a checkpoint.
+     */
+    long loadCheckpoint(CSV& csv, const std::string& fileOrURL);
+
+    /**
+     * Replay the tail of a table's redo log (i.e., the changes made after
+     * its latest checkpoint or, if there is no checkpoint, after it was
+     * last saved) and attach the log to the table for further updates. A
+     * recovered table is marked dirty as its changes are not yet saved.
+     *
+     * @param table The freshly loaded table.
+     *
+     * @param fileOrURL The path or URL identifying the table.
+     *
+     * @param generation The generation returned by loadCheckpoint().
+     */
+    void recoverTable(TableEntry& table, const std::string& fileOrURL,
+                      const long generation);
+
+    /**
+     * Write a checkpoint of each table that was updated since its last
+     * checkpoint and delete the older generations of its redo log. This
+     * method is run periodically by the saveJobs thread.
+     */
+    void checkpointTables();
+
+    /**
+     * Delete the checkpoint and the redo log of a table once its changes
+     * have been saved, unless it was updated again in the meantime. This
+     * method is run by the saveJobs thread after a successful save.
+     *
+     * @param table The table that was saved.
+     *
+     * @param fileOrURL The path or URL identifying the table.
+     */
+    void discardCheckpoint(TableEntry& table, const std::string& fileOrURL);
+
+    /** The options given to "use" statements for a table */
+    struct TableOptions {
+        /** Load the columns of the table only when they are used */
+        bool lazy = false;
+
+        /** The table is never updated. It is read without any locks. */
+        bool readOnly = false;
+
+        /** The key column on which the table is partitioned, if any */
+        std::string partitionKey;
+
+        /** The number of shards if the table is partitioned */
+        size_t numShards = 0;
+    };
+
+    /**
+     * Partition the rows of a loaded table into shards (see ShardIndex).
+     * This method waits for the queries using the table to finish.
+     *
+     * @param table The table to be partitioned.
+     *
+     * @param keyColName The name of the key column.
+     *
+     * @param numShards The number of shards.
+     *
+     * @exception Exp This method throws an exception if the key column is
+     * not in the table.
+     */
+    void partitionTable(TableEntry& table, const std::string& keyColName,
+                        const size_t numShards);
+
+    /**
+     * Partition a table that is being loaded, if it was partitioned with
+     * an earlier "use" statement (e.g., before it was evicted).
+     *
+     * @param table The freshly loaded table.
+     *
+     * @param options The options for the table.
+     */
+    void partitionLoaded(TableEntry& table, const TableOptions& options);
+
+    /**
+     * Find the only rows that may match a where clause with a "key = value"
+     * condition on the key of a partitioned table.
+     *
+     * @note The caller must hold the table's tableMutex (in shared mode).
+     *
+     * @param table The table used by the query.
+     *
+     * @param where The prepared where clause.
+     *
+     * @return The rows in the shard for the value, or nullptr if the query
+     * cannot be routed to one shard.
+     */
+    const std::vector<size_t>* routeRows(const TableEntry& table,
+                                         const WhereClause& where) const;
+
+    /**
+     * The workers that check the shards of partitioned tables in parallel.
+     * The number of workers is set by SQLAIR_SHARD_WORKERS (by default,
+     * the number of CPUs).
+     */
+    std::unique_ptr<ShardExecutor> shardExecutor;
+
+    /**
+     * Make a loaded table immutable. This method waits for the queries
+     * using the table to finish. Thereafter, selects read the rows without
+     * any locks or copies and updates throw an exception. Rows appended to
+     * the file cause the whole table to be reloaded and replaced.
+     *
+     * @param table The table to be made read-only.
+     */
+    void freezeTable(TableEntry& table);
+
+    /** The options for the tables, indexed by their path or URL */
+    ShardedMap<std::string, TableOptions> tableOptions;
+
+    /**
+     * Load the columns used by a query if the table was loaded lazily.
+     * This method must be called before the query locks the table.
+     *
+     * @param table The table used by the query.
+     *
+     * @param colNames The names of the columns used by the query.
+     *
+     * @param whereColIdx The index of the column in the where clause, or
+     * -1 if the query does not have a where clause.
+     */
+    void ensureColumns(TableEntry& table, const StrVec& colNames,
+                       const int whereColIdx);
+
+    /**
+     * Obtain the indexes of all the columns of a table.
+     *
+     * @param csv The table whose columns are to be returned.
+     *
+     * @return The indexes 0, 1, ... for each column in the table.
+     */
+    static std::vector<int> allColumns(const CSV& csv);
+
+    /** Flag to indicate if updates are logged and checkpointed */
+    bool checkpointing = false;
+
+    /** The redo logs of the tables, indexed by their path or URL */
+    ShardedMap<std::string, std::shared_ptr<RedoLog>> redoLogs;
+
+    /**
+     * Freeze a version of the recently used CSV of the current session (see
+     * TableVersion) and queue a job to save it in the background. The version
+     * shares the rows of the table, which are copied only when they are
+     * changed, and updates are not blocked while the data is written.
+     *
+     * @param[out] fileName The path or URL of the CSV being saved.
+     *
+     * @return The job number of the save (see SaveJobs).
+     *
+     * @exception Exp This method throws an exception if there is no CSV to
+     * be saved.
+     */
+    long startSave(std::string& fileName);
+
+    /**
+     * Save a CSV to a local file. The data is written to a temporary file
+     * that is flushed to disk (via fsync) and then renamed to replace the
+     * file. Hence the file is never partially written.
+     *
+     * @param table The table being saved. Its information about the source
+     * file is updated so that the watcher does not reload the saved file.
+     *
+     * @param version The version of the CSV that is actually written.
+     *
+     * @param fileName The path to the file.
+     *
+     * @exception Exp This method throws an exception if the file could not
+     * be written.
+     */
+    void saveToFile(TableEntry& table, const TableVersion& version,
+                    const std::string& fileName);
+
+    /**
+     * Save a CSV to a web-server. The CSV is streamed as the chunked body of
+     * a HTTP request (see HttpUpload) so that the whole CSV is never held
+     * in memory. The request is configured via the following environment
+     * variables:
+     *
+     *   - SQLAIR_SAVE_METHOD: The HTTP method to be used. The default is
+     *     "PUT". Some servers require "POST".
+     *   - SQLAIR_SAVE_GZIP: If this is set to 1, the body is compressed
+     *     with gzip. This requires compiling with -DSQLAIR_USE_ZLIB.
+     *
+     * @param version The version of the CSV to be saved.
+     *
+     * @param url The URL to where the CSV is to be saved.
+     *
+     * @exception Exp This method throws an exception if the CSV could not
+     * be sent or the server did not respond with a 2xx status code.
+     */
+    void saveToURL(const TableVersion& version, const std::string& url);
+
+    /**
+     * Reload a table whose file was changed by another process. This method
+     * is called from the watcher's background thread. If the file was only
+     * appended to, then just the new rows are loaded and appended to the
+     * table (see appendRows()). Otherwise the whole file is loaded and the
+     * new table atomically replaces the old one in the catalog. Tables with
+     * unsaved changes are not reloaded and changes made by saveQuery() are
+     * ignored.
+     *
+     * @param path The path to the file that changed.
+     */
+    void reloadTable(const std::string& path);
+
+    /**
+     * Load the rows appended to a file since it was loaded and append them
+     * to the table. Only complete lines (ending with a newline) are loaded.
+     *
+     * @param table The table to which the rows are to be appended.
+     *
+     * @param path The path to the file.
+     *
+     * @return The number of rows that were appended. This method returns
+     * zero without appending any rows if the table is read-only, as such
+     * tables are read without any locks.
+     */
+    size_t appendRows(TableEntry& table, const std::string& path);
+
+    /** Flag to indicate if loaded local files are watched for changes */
+    bool watchFiles = true;
+
+    /**
+     * The catalog of CSV files that have been accessed in recent queries.
+     * The catalog is used to provide convenient/rapid access to CSV files
+     * that the user has recently worked with. It ensures that each CSV is
+     * loaded only once even if many threads request it at the same time.
+     * The most recent CSV used is tracked by the recentCSV instance
+     * variable. See the loadAndGet() method in this class.
+     */
+    TableCatalog inMemoryCSV;
+
+    /**
+     * The watcher that detects changes to the local files in inMemoryCSV.
+     * It is declared after inMemoryCSV so that its background thread is
+     * stopped before the catalog is destroyed.
+     */
+    FileWatcher watcher{[this](const std::string& path) {
+        reloadTable(path); }};
+
     /**
-     * An unordered map to maintain the CSV files that have been accessed
-     * in recent queries.  This map is used to provide convenient/rapid
-     * access to CSV files that the user has recently worked with. The most
-     * recent CSV used is tracked by the recentCSV instance variable. See the
-     * getOrLoadCSV() method in this class.
+     * The queue of background saves. It is declared after the catalog so
+     * that pending saves are finished before the catalog is destroyed.
      */
-    std::unordered_map<std::string, CSV> inMemoryCSV;
+    SaveJobs saveJobs;
     
     // -------------[ Limit number of threads ]-------------------    
     /** The atomic counter that tracks the number of active threads.
@@ -0,0 +1,101 @@
+/*
+ * Implementation of the queue of background save operations.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include "SaveJobs.h"
+
+#include <iostream>
+#include <string>
+#include "AllocTracker.h"
+
+SaveJobs::SaveJobs() : worker(&SaveJobs::run, this) {
+}
+
+SaveJobs::~SaveJobs() {
+    {
+        std::scoped_lock<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+    worker.join();
+}
+
+long SaveJobs::submit(const Job& job) {
+    std::scoped_lock<std::mutex> lock(mutex);
+    // The job's allocations are counted for the query that submitted it
+    queue.emplace_back(nextId, AllocTracker::wrap(job));
+    changed.notify_all();
+    return nextId++;
+}
+
+void SaveJobs::wait(const long id) {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this, id] { return lastDone >= id; });
+    const auto error = errors.find(id);
+    if (error != errors.end()) {
+        const std::exception_ptr exp = error->second;
+        errors.erase(error);
+        std::rethrow_exception(exp);
+    }
+}
+
+void SaveJobs::every(const long millis, const Job& job) {
+    std::scoped_lock<std::mutex> lock(mutex);
+    periodicJob = job;
+    period = std::chrono::milliseconds(millis);
+    nextPeriodic = std::chrono::steady_clock::now() + period;
+    changed.notify_all();
+}
+
+void SaveJobs::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        const auto ready = [this] { return stopping || !queue.empty(); };
+        if (periodicJob) {
+            changed.wait_until(lock, nextPeriodic, ready);
+        } else {
+            changed.wait(lock, ready);
+        }
+        if (queue.empty() && stopping) {
+            return;  // Stopping and all jobs are done
+        }
+        if (queue.empty()) {
+            if (periodicJob &&
+                std::chrono::steady_clock::now() >= nextPeriodic) {
+                const Job job = periodicJob;
+                lock.unlock();
+                try {
+                    job();
+                } catch (const std::exception& exp) {
+                    std::cerr << std::string("Error in periodic job: ") +
+                                 exp.what() + "\n";
+                }
+                lock.lock();
+                nextPeriodic = std::chrono::steady_clock::now() + period;
+            }
+            continue;
+        }
+        auto [id, job] = std::move(queue.front());
+        queue.pop_front();
+        lock.unlock();
+        std::exception_ptr error;
+        try {
+            job();
+        } catch (const std::exception& exp) {
+            error = std::current_exception();
+            std::cerr << "Error in save job " + std::to_string(id) + ": " +
+                         exp.what() + "\n";
+        }
+        lock.lock();
+        if (error) {
+            errors[id] = error;
+            if (errors.size() > MaxErrors) {
+                errors.erase(errors.begin());  // Already logged
+            }
+        }
+        lastDone = id;
+        changed.notify_all();
+    }
+}
@@ -0,0 +1,122 @@
+#ifndef SAVE_JOBS_H
+#define SAVE_JOBS_H
+
+/*
+ * A queue of save operations that are run by a background thread so that
+ * clients do not have to wait for CSVs to be written. Each save is
+ * identified by a job number that can be used to wait for it to finish.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+/**
+ * Runs jobs (one at a time, in the order they were submitted) on a
+ * background thread. Since jobs run in order, saves of the same CSV are
+ * written in the order in which they were requested.
+ */
+class SaveJobs {
+public:
+    /** The type of the function that performs a job */
+    using Job = std::function<void()>;
+
+    /**
+     * Starts the background thread that runs the jobs.
+     */
+    SaveJobs();
+
+    /**
+     * Finishes all the jobs that have been submitted and then stops the
+     * background thread.
+     */
+    ~SaveJobs();
+
+    /**
+     * Add a job to the queue.
+     *
+     * @param job The function to be run in the background.
+     *
+     * @return The job number, which can be passed to wait().
+     */
+    long submit(const Job& job);
+
+    /**
+     * Wait for a job to finish.
+     *
+     * @param id The job number returned by submit().
+     *
+     * @exception This method rethrows the exception, if any, thrown by the
+     * job. Only the errors of the latest MaxErrors failed jobs are kept
+     * (errors are also logged to std::cerr when they occur). Waiting for
+     * an older failed job does not throw.
+     */
+    void wait(const long id);
+
+    /**
+     * Set a job to be run periodically (e.g., a checkpoint) by the
+     * background thread whenever no other jobs are queued. Errors thrown by
+     * the periodic job are logged and otherwise ignored.
+     *
+     * @param millis The interval between runs of the job in milliseconds.
+     *
+     * @param job The function to be run periodically.
+     */
+    void every(const long millis, const Job& job);
+
+private:
+    /** The method run by the background thread */
+    void run();
+
+    /** The jobs that have not yet been run, along with their numbers */
+    std::deque<std::pair<long, Job>> queue;
+
+    /**
+     * The maximum number of errors kept for jobs that have not been waited
+     * for. Most saves are never waited for, so older errors are dropped.
+     */
+    static constexpr size_t MaxErrors = 64;
+
+    /**
+     * The exceptions thrown by jobs that have not been waited for, ordered
+     * by job number so that the oldest can be dropped.
+     */
+    std::map<long, std::exception_ptr> errors;
+
+    /** The optional job that is run periodically */
+    Job periodicJob;
+
+    /** The interval between runs of the periodic job */
+    std::chrono::milliseconds period;
+
+    /** The time when the periodic job is to be run next */
+    std::chrono::steady_clock::time_point nextPeriodic;
+
+    /** The number to be assigned to the next job */
+    long nextId = 1;
+
+    /** The number of the most recent job that has finished */
+    long lastDone = 0;
+
+    /** Flag set to stop the background thread */
+    bool stopping = false;
+
+    /** The mutex to protect the instance variables */
+    std::mutex mutex;
+
+    /** Signaled when a job is submitted or finished */
+    std::condition_variable changed;
+
+    /** The background thread that runs the jobs */
+    std::thread worker;
+};
+
+#endif /* SAVE_JOBS_H */
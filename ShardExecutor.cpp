@@ -0,0 +1,75 @@
+/*
+ * Implementation of the worker threads for partitioned tables.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include "ShardExecutor.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <utility>
+#include "AllocTracker.h"
+
+ShardExecutor::ShardExecutor(const size_t numWorkers) {
+    const size_t numCPUs = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t i = 0; (i < std::max<size_t>(numWorkers, 1)); i++) {
+        workers.push_back(std::make_unique<Worker>());
+        Worker& worker = *workers.back();
+        worker.thread = std::thread(&ShardExecutor::run, std::ref(worker));
+        // Pinning is only an optimization. Errors (e.g., restricted CPU
+        // sets) are ignored.
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(i % numCPUs, &cpus);
+        pthread_setaffinity_np(worker.thread.native_handle(), sizeof(cpus),
+                               &cpus);
+    }
+}
+
+ShardExecutor::~ShardExecutor() {
+    for (auto& worker : workers) {
+        {
+            std::scoped_lock<std::mutex> lock(worker->mutex);
+            worker->stopping = true;
+        }
+        worker->changed.notify_all();
+    }
+    for (auto& worker : workers) {
+        worker->thread.join();
+    }
+}
+
+std::future<void> ShardExecutor::submit(const size_t shard,
+                                        const Task& task) {
+    Worker& worker = *workers[shard % workers.size()];
+    // The task's allocations are counted for the query that submitted it
+    std::packaged_task<void()> job(AllocTracker::wrap(task));
+    std::future<void> done = job.get_future();
+    {
+        std::scoped_lock<std::mutex> lock(worker.mutex);
+        worker.tasks.push_back(std::move(job));
+    }
+    worker.changed.notify_one();
+    return done;
+}
+
+void ShardExecutor::run(Worker& worker) {
+    std::unique_lock<std::mutex> lock(worker.mutex);
+    while (true) {
+        worker.changed.wait(lock, [&worker] {
+            return worker.stopping || !worker.tasks.empty(); });
+        if (worker.tasks.empty()) {
+            return;  // Stopping and all tasks are done
+        }
+        std::packaged_task<void()> task = std::move(worker.tasks.front());
+        worker.tasks.pop_front();
+        // Run the task without holding the lock. Its exception, if any,
+        // is stored in its future.
+        lock.unlock();
+        task();
+        lock.lock();
+    }
+}
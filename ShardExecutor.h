@@ -0,0 +1,91 @@
+#ifndef SHARD_EXECUTOR_H
+#define SHARD_EXECUTOR_H
+
+/*
+ * A set of worker threads that run the per-shard parts of queries on
+ * partitioned tables (see ShardIndex). The work for a given shard always
+ * runs on the same worker, and each worker is pinned to a CPU when
+ * possible, so that the rows of a shard tend to stay in the caches of
+ * one core.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Runs tasks on the worker assigned to a shard. Tasks of each worker run
+ * one at a time, in the order they were submitted.
+ */
+class ShardExecutor {
+public:
+    /** The type of the function that performs the work for a shard */
+    using Task = std::function<void()>;
+
+    /**
+     * Starts the worker threads.
+     *
+     * @param numWorkers The number of worker threads (at least 1).
+     */
+    explicit ShardExecutor(const size_t numWorkers);
+
+    /**
+     * Finishes the tasks that have been submitted and then stops the
+     * worker threads.
+     */
+    ~ShardExecutor();
+
+    /**
+     * Run a task on the worker assigned to a shard.
+     *
+     * @param shard The index of the shard. Shard i is assigned to worker
+     * i % (number of workers).
+     *
+     * @param task The function to be run by the worker.
+     *
+     * @return A future that becomes ready when the task has run. It
+     * rethrows the exception, if any, thrown by the task.
+     */
+    std::future<void> submit(const size_t shard, const Task& task);
+
+    /** Obtain the number of worker threads. */
+    size_t size() const { return workers.size(); }
+
+private:
+    /** The queue of tasks and the thread of a worker */
+    struct Worker {
+        /** The tasks that have not yet been run */
+        std::deque<std::packaged_task<void()>> tasks;
+
+        /** Flag set to stop the thread */
+        bool stopping = false;
+
+        /** The mutex to protect the tasks and the flag */
+        std::mutex mutex;
+
+        /** Signaled when a task is submitted or the worker is stopped */
+        std::condition_variable changed;
+
+        /** The thread that runs the tasks */
+        std::thread thread;
+    };
+
+    /**
+     * The method run by each worker thread.
+     *
+     * @param worker The worker whose tasks are to be run.
+     */
+    static void run(Worker& worker);
+
+    /** The workers */
+    std::vector<std::unique_ptr<Worker>> workers;
+};
+
+#endif /* SHARD_EXECUTOR_H */
@@ -0,0 +1,32 @@
+/*
+ * Implementation of the hash partitioning of the rows of a table.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include "ShardIndex.h"
+
+#include <functional>
+
+std::shared_ptr<ShardIndex> ShardIndex::build(const TableEntry& table,
+                                              const int keyColIdx,
+                                              const size_t numShards) {
+    std::shared_ptr<ShardIndex> index(new ShardIndex(keyColIdx, numShards));
+    index->add(table, 0);
+    return index;
+}
+
+void ShardIndex::add(const TableEntry& table, const size_t fromRow) {
+    for (size_t rowIdx = fromRow; (rowIdx < table.size()); rowIdx++) {
+        const TableRow& row = table.row(rowIdx);
+        // Rows without a key cannot match "key = value". Keep them in the
+        // first shard so that scans still see them.
+        const size_t shard = (static_cast<size_t>(keyColIdx) < row.size()) ?
+            shardOf(row[keyColIdx]) : 0;
+        shards[shard].push_back(rowIdx);
+    }
+}
+
+size_t ShardIndex::shardOf(std::string_view value) const {
+    return std::hash<std::string_view>()(value) % shards.size();
+}
@@ -0,0 +1,115 @@
+#ifndef SHARD_INDEX_H
+#define SHARD_INDEX_H
+
+/*
+ * Hash partitioning of the rows of a table on a key column (see "use ...
+ * partition by"). Each row is assigned to one of N shards based on the
+ * hash of its key. The rows of each shard are listed in file order so
+ * that a query with a "key = value" condition only checks the rows of
+ * one shard, and a scan can check the shards in parallel (see
+ * ShardExecutor) and still print the rows in their original order.
+ *
+ * Keys are hashed by their text, so "5" and "5.0" land in different
+ * shards (just as "=" does not consider them equal). The shards are only
+ * lists of row indexes: all shards of a table share the table's single
+ * segment store and its tableMutex. Hence sharding spreads the work of
+ * scans over several threads but does not reduce write contention --
+ * writers to different shards still serialize on the table lock.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "TableEntry.h"
+
+/**
+ * The row indexes of each shard of a partitioned table. The index is
+ * changed only while the table's tableMutex is held exclusively. Updates
+ * that change the key column mark the index stale and replace it with a
+ * rebuilt one once they finish.
+ */
+class ShardIndex {
+public:
+    /**
+     * Partition the rows of a table.
+     *
+     * @param table The table whose rows are to be partitioned. The values
+     * of its key column must have been loaded (see LazyColumns).
+     *
+     * @param keyColIdx The index of the key column.
+     *
+     * @param numShards The number of shards (at least 1).
+     *
+     * @return The index for all the rows of the table.
+     */
+    static std::shared_ptr<ShardIndex> build(const TableEntry& table,
+                                             const int keyColIdx,
+                                             const size_t numShards);
+
+    /**
+     * Add rows that were appended to the table to their shards.
+     *
+     * @note The caller must hold the table's tableMutex in exclusive mode.
+     *
+     * @param table The table to which rows were appended.
+     *
+     * @param fromRow The index of the first appended row.
+     */
+    void add(const TableEntry& table, const size_t fromRow);
+
+    /**
+     * Determine the shard that holds the rows whose key equals a value.
+     * Keys are hashed by their text, as "=" compares the text exactly.
+     *
+     * @param value The value of the key.
+     *
+     * @return The index of the shard.
+     */
+    size_t shardOf(std::string_view value) const;
+
+    /**
+     * Obtain the rows of a shard.
+     *
+     * @param shard The index of the shard.
+     *
+     * @return The indexes of the rows in the shard, in ascending order.
+     */
+    const std::vector<size_t>& getRows(const size_t shard) const {
+        return shards[shard];
+    }
+
+    /** Obtain the number of shards. */
+    size_t size() const { return shards.size(); }
+
+    /** Obtain the index of the key column. */
+    int getKeyColumn() const { return keyColIdx; }
+
+    /**
+     * Flag set by an update that changes the key column, while the shards
+     * do not reflect the changed rows. Stale indexes are not used.
+     */
+    std::atomic<bool> stale = {false};
+
+private:
+    /**
+     * The constructor is private. Instances are created via build().
+     *
+     * @param keyColIdx The index of the key column.
+     *
+     * @param numShards The number of shards.
+     */
+    ShardIndex(const int keyColIdx, const size_t numShards) :
+        keyColIdx(keyColIdx), shards(numShards) {}
+
+    /** The index of the key column */
+    const int keyColIdx;
+
+    /** The indexes of the rows in each shard */
+    std::vector<std::vector<size_t>> shards;
+};
+
+#endif /* SHARD_INDEX_H */
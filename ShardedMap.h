@@ -0,0 +1,178 @@
+#ifndef SHARDED_MAP_H
+#define SHARDED_MAP_H
+
+/*
+ * A read-optimized, MT-safe map. The keys are spread over a fixed number
+ * of shards, each of which is an unordered map with its own reader-writer
+ * lock. Lookups hold the lock of one shard in shared mode, so concurrent
+ * readers never block each other, and writers only block the readers of
+ * the same shard.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include <array>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <utility>
+
+/**
+ * An unordered map with shared lookups and sharded updates.
+ *
+ * @tparam Key The type of the keys in the map.
+ *
+ * @tparam Value The type of values in the map. Values are returned by
+ * copy. Hence this is typically a shared_ptr or shared_future.
+ *
+ * @tparam NumShards The number of shards.
+ */
+template<typename Key, typename Value, size_t NumShards = 16>
+class ShardedMap {
+public:
+    /** The type of the copies of the map returned by snapshot() */
+    using Map = std::unordered_map<Key, Value>;
+
+    /**
+     * Obtain a copy of the map, e.g., to iterate over its entries. Each
+     * shard is copied while holding its lock in shared mode.
+     *
+     * @return A copy of the entries of the map.
+     */
+    Map snapshot() const {
+        Map copy;
+        for (const auto& shard : shards) {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            copy.insert(shard.map.begin(), shard.map.end());
+        }
+        return copy;
+    }
+
+    /**
+     * Look-up a value.
+     *
+     * @param key The key to be looked-up.
+     *
+     * @param[out] value The value associated with the key, if found.
+     *
+     * @return This method returns true if the key was found.
+     */
+    bool find(const Key& key, Value& value) const {
+        const Shard& shard = shardOf(key);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        const auto entry = shard.map.find(key);
+        if (entry == shard.map.end()) {
+            return false;
+        }
+        value = entry->second;
+        return true;
+    }
+
+    /**
+     * Look-up a value and insert one if it is not present. The check and
+     * the insertion are atomic with respect to other writers.
+     *
+     * @param key The key to be looked-up.
+     *
+     * @param make A function that is called (only if the key is not found)
+     * to create the value to be inserted. It is called while holding the
+     * lock of the key's shard.
+     *
+     * @return A pair with the value associated with the key and a flag that
+     * is true if the value was inserted by this call.
+     */
+    template<typename MakeValue>
+    std::pair<Value, bool> findOrInsert(const Key& key, MakeValue make) {
+        Value value;
+        if (find(key, value)) {
+            return {value, false};  // Fast path with a shared lock
+        }
+        Shard& shard = shardOf(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        if (const auto entry = shard.map.find(key); entry != shard.map.end()) {
+            return {entry->second, false};  // Another writer inserted it
+        }
+        value = make();
+        shard.map.emplace(key, value);
+        return {value, true};
+    }
+
+    /**
+     * Replace or insert the value associated with a key.
+     *
+     * @param key The key whose value is to be set.
+     *
+     * @param value The value to be set.
+     */
+    void set(const Key& key, const Value& value) {
+        Shard& shard = shardOf(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        shard.map[key] = value;
+    }
+
+    /**
+     * Remove a key from the map.
+     *
+     * @param key The key to be removed.
+     */
+    void erase(const Key& key) {
+        Shard& shard = shardOf(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        shard.map.erase(key);
+    }
+
+    /**
+     * Remove the entries that satisfy a condition. Each shard is checked
+     * while holding its lock in exclusive mode. So no lookups of the keys
+     * in that shard are running meanwhile.
+     *
+     * @param pred A function that is called with each key and value and
+     * returns true if the entry is to be removed.
+     */
+    template<typename Predicate>
+    void eraseIf(Predicate pred) {
+        for (auto& shard : shards) {
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+            for (auto entry = shard.map.begin(); entry != shard.map.end();) {
+                entry = pred(entry->first, entry->second) ?
+                    shard.map.erase(entry) : std::next(entry);
+            }
+        }
+    }
+
+private:
+    /**
+     * A shard of the map. Shards are aligned to cache lines so that the
+     * locks of different shards do not share a cache line.
+     */
+    struct alignas(64) Shard {
+        /** The lock, held in shared mode by lookups */
+        mutable std::shared_mutex mutex;
+
+        /** The entries whose keys hash to this shard */
+        Map map;
+    };
+
+    /**
+     * Obtain the shard of a key.
+     *
+     * @param key The key.
+     *
+     * @return The shard holding the key, if present.
+     */
+    Shard& shardOf(const Key& key) {
+        return shards[std::hash<Key>()(key) % NumShards];
+    }
+
+    /** The const version of shardOf() */
+    const Shard& shardOf(const Key& key) const {
+        return shards[std::hash<Key>()(key) % NumShards];
+    }
+
+    /** The shards of the map */
+    std::array<Shard, NumShards> shards;
+};
+
+#endif /* SHARDED_MAP_H */
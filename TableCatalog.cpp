@@ -0,0 +1,189 @@
+/*
+ * Implementation of the MT-safe catalog of tables with single-flight
+ * loading and memory-budgeted eviction.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include "TableCatalog.h"
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+PinnedTable TableCatalog::get(const std::string& name, const Loader& loader) {
+    while (true) {
+        std::promise<TablePtr> promise;
+        // Only a shared lock if the table is in the catalog. Otherwise,
+        // atomically insert our future so other threads wait for this one.
+        const auto [table, inserted] = tables.findOrInsert(name, [&promise] {
+            return promise.get_future().share();
+        });
+        if (!inserted) {
+            // The table is loaded or is being loaded by another thread.
+            // Waits for load & rethrows any load errors.
+            if (PinnedTable entry = pin(table); entry != nullptr) {
+                return entry;
+            }
+            // The table is being evicted. Try again once it is gone.
+            waitEvicted(name, table.get().get());
+            continue;
+        }
+
+        // When control drops here, this thread loads the table without
+        // holding any locks.
+        TablePtr entry = std::make_shared<TableEntry>();
+        try {
+            loader(*entry);
+        } catch (...) {
+            // Remove the failed entry so that the next request retries
+            tables.erase(name);
+            promise.set_exception(std::current_exception());
+            throw;
+        }
+        entry->memoryUsage = entry->estimateMemory();
+        entry->pins++;  // Pin before it is visible to evict()
+        promise.set_value(entry);
+        PinnedTable pinned(entry);
+        touch(*entry);
+        evict();
+        return pinned;
+    }
+}
+
+PinnedTable TableCatalog::find(const std::string& name) {
+    TableFuture table;
+    while (tables.find(name, table)) {
+        if (PinnedTable entry = pin(table); entry != nullptr) {
+            return entry;
+        }
+        waitEvicted(name, table.get().get());
+    }
+    return PinnedTable();
+}
+
+void TableCatalog::replace(const std::string& name, const TablePtr& entry) {
+    std::promise<TablePtr> promise;
+    entry->memoryUsage = entry->estimateMemory();
+    touch(*entry);
+    promise.set_value(entry);
+    {
+        // Do not race with evict() removing the old table
+        std::scoped_lock<std::mutex> lock(evictMutex);
+        tables.set(name, promise.get_future().share());
+    }
+    evict();
+}
+
+PinnedTable TableCatalog::pin(const TableFuture& table) {
+    const TablePtr& entry = table.get();
+    // The pin and the check below pair with the reverse order in evict():
+    // either this thread sees the eviction or evict() sees the pin.
+    entry->pins++;
+    if (entry->evicted) {
+        entry->pins--;
+        return PinnedTable();
+    }
+    touch(*entry);
+    // The returned object shares the table (so it remains valid even if it
+    // is replaced) and unpins the table.
+    return PinnedTable(entry);
+}
+
+void TableCatalog::touch(TableEntry& entry) {
+    entry.lastUsed.store(
+        std::chrono::steady_clock::now().time_since_epoch().count(),
+        std::memory_order_relaxed);
+}
+
+void TableCatalog::waitEvicted(const std::string& name,
+                               const TableEntry* entry) {
+    std::unique_lock<std::mutex> lock(evictedMutex);
+    evictedCond.wait(lock, [&] { return !holds(name, entry); });
+}
+
+bool TableCatalog::holds(const std::string& name,
+                         const TableEntry* entry) const {
+    TableFuture table;
+    if (!tables.find(name, table) ||
+        table.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return false;  // Removed, or a new load of the table
+    }
+    try {
+        return table.get().get() == entry;
+    } catch (...) {
+        return false;  // A failed new load of the table
+    }
+}
+
+long TableCatalog::evict() {
+    // The tables to be evicted, chosen while holding evictMutex
+    std::vector<std::pair<std::string, TablePtr>> victims;
+    long totalMemory = 0;
+    {
+        std::scoped_lock<std::mutex> lock(evictMutex);
+        // Collect the tables that have finished loading
+        std::vector<std::pair<std::string, TablePtr>> loaded;
+        for (const auto& [name, table] : tables.snapshot()) {
+            if (table.wait_for(std::chrono::seconds(0)) ==
+                std::future_status::ready) {
+                try {
+                    TablePtr entry = table.get();
+                    if (!entry->evicted) {  // Not evicted by another thread
+                        totalMemory += entry->memoryUsed();
+                        loaded.emplace_back(name, std::move(entry));
+                    }
+                } catch (...) {
+                    // Failed loads are removed by the loading thread
+                }
+            }
+        }
+        const long budget = memoryBudget;
+        if (budget <= 0 || totalMemory <= budget) {
+            return totalMemory;
+        }
+        // Evict the least recently used tables first
+        std::sort(loaded.begin(), loaded.end(), [](const auto& t1,
+                                                   const auto& t2) {
+            return t1.second->lastUsed.load(std::memory_order_relaxed) <
+                t2.second->lastUsed.load(std::memory_order_relaxed);
+        });
+        for (auto& [name, entry] : loaded) {
+            if (totalMemory <= budget) {
+                break;
+            }
+            if (entry->pins > 0 || entry->dirty) {
+                continue;  // In use or has unsaved changes
+            }
+            entry->evicted = true;
+            if (entry->pins > 0 || entry->dirty) {
+                entry->evicted = false;  // Pinned concurrently
+                continue;
+            }
+            totalMemory -= entry->memoryUsed();
+            victims.emplace_back(name, entry);
+        }
+    }
+    for (auto& [name, entry] : victims) {
+        // No thread can use the table now. So it is safe to snapshot it
+        // without blocking lookups of other tables.
+        if (onEvict) {
+            try {
+                onEvict(name, *entry);
+            } catch (const std::exception&) {
+                // A snapshot is only an optimization. Evict anyway.
+            }
+        }
+        {
+            // The table may have been replaced (see replace()) meanwhile
+            std::scoped_lock<std::mutex> lock(evictMutex);
+            if (holds(name, entry.get())) {
+                tables.erase(name);
+            }
+        }
+        // Wake-up threads waiting to load the table again
+        std::scoped_lock<std::mutex> lock(evictedMutex);
+        evictedCond.notify_all();
+    }
+    return totalMemory;
+}
@@ -0,0 +1,188 @@
+#ifndef TABLE_CATALOG_H
+#define TABLE_CATALOG_H
+
+/*
+ * A MT-safe catalog of the CSV files (tables) that have been loaded into
+ * memory. Loading is "single-flight": the first thread to request a table
+ * loads it while other threads requesting the same table wait for that
+ * load to finish (instead of loading it again). Lookups of other tables
+ * are not blocked while a table is being loaded. Looking up a table that
+ * is already loaded only holds a shared lock (see ShardedMap) and does not
+ * allocate memory.
+ *
+ * The catalog can be given a memory budget. When the estimated memory used
+ * by the tables exceeds the budget, the least recently used tables that are
+ * clean (i.e., have no unsaved changes) and are not in use are evicted. An
+ * evicted table is transparently loaded again on its next use. The handler
+ * called for each evicted table (e.g., to snapshot it) runs without holding
+ * any locks of the catalog. Threads that look-up a table while it is being
+ * evicted wait until it is removed and then load it again.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include "ShardedMap.h"
+#include "TableEntry.h"
+
+/**
+ * The catalog of tables used by SQLAir. Each table is identified by the
+ * path or URL from where it was loaded.
+ */
+class TableCatalog {
+public:
+    /**
+     * The type of the function used to load a table. The function must
+     * load the data into the supplied entry (see TableEntry::adopt()) or
+     * throw an exception.
+     */
+    using Loader = std::function<void(TableEntry& table)>;
+
+    /**
+     * The type of the function called just before a table is evicted. The
+     * table is not used by any other thread while this function runs, and
+     * the catalog is not locked.
+     */
+    using EvictHandler = std::function<void(const std::string& name,
+                                            TableEntry& table)>;
+
+    /**
+     * Obtain a table from the catalog, loading it if needed. If the table
+     * is already being loaded by another thread, then this method waits
+     * for that load to finish.
+     *
+     * @param name The path or URL identifying the table.
+     *
+     * @param loader The function to be used to load the table, if the
+     * table is not already in the catalog.
+     *
+     * @return The table, pinned in memory until the returned object (and
+     * all copies of it) are released. This method never returns nullptr.
+     *
+     * @exception This method throws the exception thrown by the loader. A
+     * table that failed to load is not kept in the catalog so that a
+     * subsequent request tries to load it again.
+     */
+    PinnedTable get(const std::string& name, const Loader& loader);
+
+    /**
+     * Obtain a table only if it is already loaded (or being loaded).
+     *
+     * @param name The path or URL identifying the table.
+     *
+     * @return The table (pinned in memory) or nullptr if the table is not
+     * in the catalog.
+     */
+    PinnedTable find(const std::string& name);
+
+    /**
+     * Atomically replace a table in the catalog, e.g., with a freshly
+     * loaded copy of a changed file. Queries that are using the old table
+     * continue to use it until they finish.
+     *
+     * @param name The path or URL identifying the table.
+     *
+     * @param entry The new table. It is used by all subsequent queries.
+     */
+    void replace(const std::string& name, const TablePtr& entry);
+
+    /**
+     * Set the memory budget for the tables in the catalog. Tables are
+     * evicted (if possible) whenever a table is loaded and the budget is
+     * exceeded.
+     *
+     * @param bytes The budget in bytes. Zero or a negative value (the
+     * default) disables eviction.
+     */
+    void setMemoryBudget(const long bytes) { memoryBudget = bytes; }
+
+    /**
+     * Set the function to be called just before a table is evicted.
+     *
+     * @param handler The handler, typically used to write a snapshot of the
+     * table for faster reloading.
+     */
+    void setEvictHandler(const EvictHandler& handler) { onEvict = handler; }
+
+    /**
+     * Evict the least recently used tables until the memory used by the
+     * tables is within the budget. Tables that are pinned or dirty are not
+     * evicted. Hence the memory used may remain over the budget. The
+     * chosen tables are marked as evicted while holding evictMutex. Then
+     * the evict handler is called for each of them without holding the
+     * mutex, after which they are removed from the catalog.
+     *
+     * @return The estimated memory used by the tables after eviction.
+     */
+    long evict();
+
+private:
+    /** The type of the future that is ready once a table is loaded */
+    using TableFuture = std::shared_future<TablePtr>;
+
+    /**
+     * Pin a table so that it is not evicted.
+     *
+     * @param table The future for the table to be pinned.
+     *
+     * @return An object that unpins the table when it is released, or
+     * nullptr if the table is being evicted (and must be looked-up again).
+     */
+    PinnedTable pin(const TableFuture& table);
+
+    /**
+     * Record the time of an access to a table (see TableEntry::lastUsed).
+     *
+     * @param entry The table being accessed.
+     */
+    static void touch(TableEntry& entry);
+
+    /**
+     * Wait until a table that is being evicted is removed from the catalog
+     * (or replaced).
+     *
+     * @param name The path or URL identifying the table.
+     *
+     * @param entry The table being evicted.
+     */
+    void waitEvicted(const std::string& name, const TableEntry* entry);
+
+    /**
+     * Determine if the catalog has a given loaded table.
+     *
+     * @param name The path or URL identifying the table.
+     *
+     * @param entry The table to be checked.
+     *
+     * @return This method returns true if name maps to entry.
+     */
+    bool holds(const std::string& name, const TableEntry* entry) const;
+
+    /** The tables in the catalog, indexed by their path or URL. The map is
+     * never locked while a table is being loaded.
+     */
+    ShardedMap<std::string, TableFuture> tables;
+
+    /** The memory budget in bytes. Zero or less means unlimited. */
+    std::atomic<long> memoryBudget = {0};
+
+    /**
+     * Mutex to ensure only one thread chooses the tables to be evicted at a
+     * time. It is also held while evicted tables are removed.
+     */
+    std::mutex evictMutex;
+
+    /** The mutex and condition used to wait for evictions to finish */
+    std::mutex evictedMutex;
+    std::condition_variable evictedCond;
+
+    /** The optional function called before a table is evicted */
+    EvictHandler onEvict;
+};
+
+#endif /* TABLE_CATALOG_H */
@@ -0,0 +1,94 @@
+/*
+ * Implementation of the copy-on-write segments of the rows of a table.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include "TableEntry.h"
+
+#include <algorithm>
+#include "TableSnapshot.h"
+
+long TableEntry::append(std::vector<CSVRow>& rows) {
+    if (!rows.empty() && numRows % SegmentRows != 0) {
+        // Versions holding the last segment must not see the new rows
+        writableRow(numRows - 1);
+    }
+    releaseStale();
+    long bytes = 0;
+    for (auto& row : rows) {
+        if (numRows % SegmentRows == 0) {
+            Slot& slot = slots.emplace_back();
+            slot.owner = std::make_shared<Segment>();
+            slot.owner->reserve(SegmentRows);
+            slot.rows = slot.owner.get();
+            bytes += SegmentRows * sizeof(TableRow);
+        }
+        TableRow& packed = slots.back().owner->emplace_back();
+        packed.assign(row.begin(), row.end());
+        bytes += packed.capacity();
+        StrVec().swap(row);  // Free the cells as soon as they are packed
+        numRows++;
+    }
+    return bytes;
+}
+
+TableRow& TableEntry::writableRow(const size_t rowIdx) {
+    Slot& slot = slots[rowIdx / SegmentRows];
+    std::scoped_lock<std::mutex> lock(slot.mutex);
+    if (slot.owner.use_count() > 1) {
+        // A version holds the segment. The segment no longer changes, so
+        // it can be copied while other queries read it.
+        auto copy = std::make_shared<Segment>();
+        copy->reserve(SegmentRows);
+        copy->assign(slot.owner->begin(), slot.owner->end());
+        {
+            std::scoped_lock<std::mutex> retiredLock(retiredMutex);
+            retained.emplace_back(slot.owner,
+                                  TableSnapshot::estimateMemory(*slot.owner));
+            stale.push_back(slot.owner);
+        }
+        slot.stale.store(slot.owner.get(), std::memory_order_release);
+        slot.owner = std::move(copy);
+        slot.rows.store(slot.owner.get(), std::memory_order_release);
+    }
+    return (*slot.owner)[rowIdx % SegmentRows];
+}
+
+std::vector<TableEntry::SegmentPtr> TableEntry::share() {
+    releaseStale();
+    std::vector<SegmentPtr> segments;
+    segments.reserve(slots.size());
+    for (const auto& slot : slots) {
+        segments.push_back(slot.owner);
+    }
+    return segments;
+}
+
+void TableEntry::releaseStale() {
+    for (auto& slot : slots) {
+        slot.stale.store(nullptr, std::memory_order_relaxed);
+    }
+    std::scoped_lock<std::mutex> lock(retiredMutex);
+    stale.clear();
+}
+
+long TableEntry::estimateMemory() const {
+    long bytes = 0;
+    for (const auto& slot : slots) {
+        bytes += TableSnapshot::estimateMemory(*slot.owner);
+    }
+    return bytes;
+}
+
+long TableEntry::memoryUsed() {
+    long bytes = memoryUsage;
+    std::scoped_lock<std::mutex> lock(retiredMutex);
+    retained.erase(std::remove_if(retained.begin(), retained.end(),
+        [](const auto& segment) { return segment.first.expired(); }),
+        retained.end());
+    for (const auto& segment : retained) {
+        bytes += segment.second;
+    }
+    return bytes;
+}
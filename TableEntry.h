@@ -0,0 +1,390 @@
+#ifndef TABLE_ENTRY_H
+#define TABLE_ENTRY_H
+
+/*
+ * The entry for a loaded table in the catalog (see TableCatalog). The
+ * entry owns the CSV with the table's column names along with the
+ * information that SQLAir tracks for the table (locks, caches, the state
+ * of its source file, etc.). This information is kept out of the CSV class
+ * so that the layout of CSV matches the prebuilt library that implements
+ * its methods.
+ *
+ * The rows of the table are packed (see TableRow) and stored in
+ * reference-counted segments (blocks of consecutive rows) that are shared
+ * with the immutable versions of the table (see TableVersion). Creating a
+ * version only copies the pointers to the segments. A segment that is
+ * shared with a version is copied the first time one of its rows is
+ * changed (copy-on-write), so versions never observe changes and
+ * unchanged segments are never copied.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <utility>
+#include <vector>
+#include "CSV.h"
+#include "Numeric.h"
+#include "PackedRow.h"
+
+// Forward declarations to avoid circular dependencies with these headers
+class LazyColumns;
+class RedoLog;
+class ShardIndex;
+
+/**
+ * A loaded table: its CSV and the information associated with it. Entries
+ * are shared by the catalog and the queries using them (see TablePtr).
+ */
+class TableEntry {
+public:
+    /** The type of a segment, i.e., a block of consecutive rows */
+    using Segment = std::vector<TableRow>;
+
+    /** A shared pointer to a segment that is no longer changed */
+    using SegmentPtr = std::shared_ptr<const Segment>;
+
+    /** The number of rows in each segment (except perhaps the last one) */
+    static constexpr size_t SegmentRows = 4096;
+
+    /**
+     * Move the rows loaded into the CSV to the end of the table. The
+     * loaders (e.g., CSV::load) fill the CSV, after which its rows are
+     * adopted by the table and the CSV only has the column names.
+     *
+     * @note The caller must hold tableMutex in exclusive mode, unless the
+     * table is not yet visible to other threads.
+     */
+    void adopt() {
+        append(csv);
+        csv.clear();
+    }
+
+    /**
+     * Pack rows and add them to the end of the table. The last segment is
+     * copied first if it is shared with a version.
+     *
+     * @note The caller must hold tableMutex in exclusive mode, unless the
+     * table is not yet visible to other threads.
+     *
+     * @param rows The rows to be appended. The cells of each row are freed
+     * once they are packed, leaving empty rows.
+     *
+     * @return The estimated number of bytes used by the appended rows.
+     */
+    long append(std::vector<CSVRow>& rows);
+
+    /**
+     * Obtain the number of rows in the table.
+     *
+     * @return The number of rows.
+     */
+    size_t size() const { return numRows; }
+
+    /**
+     * Obtain a row of the table for reading. The row must be read while
+     * holding its rowMutex, as concurrent updates may change it. It must
+     * be changed only via writableRow().
+     *
+     * @note The caller must hold tableMutex (in shared mode).
+     *
+     * @param rowIdx The zero-based index of the row.
+     *
+     * @return The row.
+     */
+    TableRow& row(const size_t rowIdx) {
+        return (*slots[rowIdx / SegmentRows].rows.load(
+            std::memory_order_acquire))[rowIdx % SegmentRows];
+    }
+
+    /**
+     * Obtain a row of the table for reading, e.g., while holding tableMutex
+     * in exclusive mode.
+     *
+     * @param rowIdx The zero-based index of the row.
+     *
+     * @return The row.
+     */
+    const TableRow& row(const size_t rowIdx) const {
+        return const_cast<TableEntry*>(this)->row(rowIdx);
+    }
+
+    /**
+     * Obtain a row of the table for changing it. If the row's segment is
+     * shared with a version, the segment is copied first. Writers must
+     * hold the rowMutex of the returned row and of the row returned by
+     * staleRow(), if any.
+     *
+     * @note The caller must hold tableMutex (in shared mode).
+     *
+     * @param rowIdx The zero-based index of the row.
+     *
+     * @return The row, which is not shared with any version.
+     */
+    TableRow& writableRow(const size_t rowIdx);
+
+    /**
+     * Obtain the copy of a row in the segment that was replaced by the
+     * latest copy-on-write of the row's segment. Queries that obtained the
+     * row before its segment was copied may still be reading this copy.
+     *
+     * @note The caller must hold tableMutex (in shared mode).
+     *
+     * @param rowIdx The zero-based index of the row.
+     *
+     * @return The stale copy of the row or nullptr if the row's segment
+     * has not been copied since tableMutex was last held exclusively.
+     */
+    TableRow* staleRow(const size_t rowIdx) {
+        Segment* const stale = slots[rowIdx / SegmentRows].stale.load(
+            std::memory_order_acquire);
+        return (stale != nullptr ? &(*stale)[rowIdx % SegmentRows] :
+                nullptr);
+    }
+
+    /**
+     * Share the segments of the table, e.g., to create a version of it.
+     * Rows of shared segments are copied before they are changed.
+     *
+     * @note The caller must hold tableMutex in exclusive mode so that no
+     * row is being changed.
+     *
+     * @return The segments, in order.
+     */
+    std::vector<SegmentPtr> share();
+
+    /**
+     * Estimate the memory used by the rows of the table, e.g., once it has
+     * been loaded.
+     *
+     * @note The caller must hold tableMutex in exclusive mode, unless the
+     * table is not yet visible to other threads.
+     *
+     * @return The estimated number of bytes used by the rows.
+     */
+    long estimateMemory() const;
+
+    /**
+     * Obtain the memory used by this table, i.e., memoryUsage plus the
+     * segments that were replaced by copy-on-write but are still held by
+     * versions of the table.
+     *
+     * @return The estimated number of bytes used by the table.
+     */
+    long memoryUsed();
+
+    /**
+     * The column names of the table. Its rows are only used by loaders and
+     * are moved to the table's segments (see adopt()).
+     */
+    CSV csv;
+
+    /**
+     * Cached numeric values of columns that are compared against numbers in
+     * where clauses. See the NumericShadow class for details.
+     */
+    NumericShadow numericShadow;
+
+    /**
+     * Flag to indicate that rows were changed since this table was loaded
+     * or saved. Dirty tables are never evicted from memory.
+     */
+    std::atomic<bool> dirty = {false};
+
+    /**
+     * The number of queries that changed or appended rows of this table.
+     * It is incremented while the tableMutex is held (in shared mode by
+     * updates), so a thread that holds the mutex exclusively can check
+     * whether the rows changed since it last read this value.
+     */
+    std::atomic<long> changes = {0};
+
+    /**
+     * The estimated number of bytes of memory used by the rows of this
+     * table. This value is set when the table is loaded and adjusted when
+     * values change. Also see memoryUsed().
+     */
+    std::atomic<long> memoryUsage = {0};
+
+    /**
+     * The time (in ticks of std::chrono::steady_clock) of the most recent
+     * access to this table. This value is used to evict the least recently
+     * used tables from memory. It is only an approximate hint. Hence it is
+     * read and written with relaxed memory ordering.
+     */
+    std::atomic<long> lastUsed = {0};
+
+    /**
+     * Flag to indicate that this table is immutable (see "use ... readonly").
+     * Its rows are read without any locks and updates are rejected.
+     */
+    std::atomic<bool> readOnly = {false};
+
+    /**
+     * The number of queries currently using this table. A table is never
+     * evicted from memory while it is in use.
+     */
+    std::atomic<int> pins = {0};
+
+    /**
+     * Flag set by TableCatalog while it is evicting this table. Queries
+     * that find this flag set wait until the table is removed from the
+     * catalog and then look it up again.
+     */
+    std::atomic<bool> evicted = {false};
+
+    /**
+     * A table-level lock. Queries hold it in shared mode while accessing
+     * rows. It is held in exclusive mode only while rows are appended to
+     * this table and while its segments are shared with a version (so that
+     * the version matches, e.g., a position in the redo log).
+     */
+    std::shared_mutex tableMutex;
+
+    /**
+     * The number of bytes of the source file that have been loaded into
+     * this table, or -1 if the table was not loaded from a local file. Rows
+     * appended to the file after this offset can be loaded incrementally.
+     */
+    std::atomic<long> sourceSize = {-1};
+
+    /** The modification time of the source file when it was loaded */
+    std::atomic<long long> sourceMTime = {0};
+
+    /**
+     * A hash of the bytes at the end of the loaded part of the source file.
+     * It is used to check that a file that grew was only appended to.
+     */
+    std::atomic<size_t> sourceFingerprint = {0};
+
+    /**
+     * The redo log to which updates to this table are recorded, or nullptr
+     * if checkpointing is disabled (see SQLAir::recoverTable).
+     */
+    std::shared_ptr<RedoLog> redoLog;
+
+    /**
+     * The columns that are yet to be loaded if this table was loaded lazily
+     * (see LazyColumns), or nullptr if all columns were loaded.
+     */
+    std::shared_ptr<LazyColumns> lazy;
+
+    /**
+     * The rows in each shard if this table is partitioned on a key column
+     * (see ShardIndex), or nullptr. It is changed only while tableMutex is
+     * held exclusively.
+     */
+    std::shared_ptr<ShardIndex> shards;
+
+private:
+    /** A segment of the table and the information to copy it on write */
+    struct Slot {
+        /** The segment. It is replaced only while holding mutex. */
+        std::shared_ptr<Segment> owner;
+
+        /** The segment, read by queries without holding mutex */
+        std::atomic<Segment*> rows = {nullptr};
+
+        /**
+         * The segment replaced by the latest copy-on-write, if any. It is
+         * reset whenever tableMutex is held exclusively.
+         */
+        std::atomic<Segment*> stale = {nullptr};
+
+        /** The mutex to copy the segment at most once */
+        std::mutex mutex;
+    };
+
+    /**
+     * Release the segments replaced by copy-on-write. Queries may read
+     * them (see staleRow()) only while tableMutex is held in shared mode.
+     *
+     * @note The caller must hold tableMutex in exclusive mode.
+     */
+    void releaseStale();
+
+    /** The segments with the rows. Slots are added only by append(). */
+    std::deque<Slot> slots;
+
+    /** The number of rows in the table */
+    size_t numRows = 0;
+
+    /** The segments replaced by copy-on-write. See releaseStale(). */
+    std::vector<std::shared_ptr<Segment>> stale;
+
+    /**
+     * The segments replaced by copy-on-write along with their estimated
+     * memory. They use memory until the versions holding them are gone.
+     */
+    std::vector<std::pair<std::weak_ptr<const Segment>, long>> retained;
+
+    /** The mutex to protect stale and retained */
+    std::mutex retiredMutex;
+};
+
+/** A short cut to refer to a shared pointer to a loaded table */
+using TablePtr = std::shared_ptr<TableEntry>;
+
+/**
+ * A table "pinned" in memory, as returned by TableCatalog. A pinned table
+ * is never evicted. Copies of this object share the table and each holds
+ * its own pin, which is released when the copy is destroyed. Unlike a
+ * shared pointer with a custom deleter, pinning does not allocate memory.
+ */
+class PinnedTable {
+public:
+    /** Creates an empty object that does not refer to any table */
+    PinnedTable() = default;
+
+    /**
+     * Takes over a pin of a table.
+     *
+     * @param entry The table, whose pins have already been incremented.
+     */
+    explicit PinnedTable(TablePtr entry) : entry(std::move(entry)) {}
+
+    /** Pins the table of another object again */
+    PinnedTable(const PinnedTable& src) : entry(src.entry) {
+        if (entry != nullptr) {
+            entry->pins++;
+        }
+    }
+
+    /** Takes over the pin of another object */
+    PinnedTable(PinnedTable&& src) = default;
+
+    /** Releases the current pin and takes over a copy of another object */
+    PinnedTable& operator=(PinnedTable src) {
+        std::swap(entry, src.entry);
+        return *this;
+    }
+
+    /** Releases the pin, if any */
+    ~PinnedTable() {
+        if (entry != nullptr) {
+            entry->pins--;
+        }
+    }
+
+    /** Access the pinned table */
+    TableEntry* operator->() const { return entry.get(); }
+
+    /** Access the pinned table */
+    TableEntry& operator*() const { return *entry; }
+
+    /** Determine if this object refers to a table */
+    bool operator==(std::nullptr_t) const { return entry == nullptr; }
+
+    /** Determine if this object refers to a table */
+    bool operator!=(std::nullptr_t) const { return entry != nullptr; }
+
+private:
+    /** The pinned table or nullptr */
+    TablePtr entry;
+};
+
+#endif /* TABLE_ENTRY_H */
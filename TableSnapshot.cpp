@@ -0,0 +1,147 @@
+/*
+ * Implementation of the binary snapshots of CSV data.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include "TableSnapshot.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include "Helper.h"
+
+/** The first line in every snapshot file */
+const std::string SnapshotMagic = "SQLAIR-SNAPSHOT 2";
+
+void TableSnapshot::save(const TableVersion& version,
+                         const std::string& path, const std::string& stamp,
+                         const bool durable) {
+    const std::string tmpPath = path + ".tmp";
+    std::ofstream out(tmpPath, std::ios::binary);
+    if (!out.good()) {
+        throw Exp("Unable to write snapshot " + tmpPath);
+    }
+    out << SnapshotMagic << '\n' << stamp << '\n';
+    std::string delim = "";
+    for (const auto& colName : version.getColumnNames()) {
+        out << delim << '"' << colName << '"';
+        delim = ",";
+    }
+    out << '\n' << version.size() << '\n';
+    for (const auto& segment : version.getSegments()) {
+        for (const auto& row : *segment) {
+            const uint32_t numCells = row.size();
+            out.write(reinterpret_cast<const char*>(&numCells),
+                      sizeof(numCells));
+            for (size_t i = 0; (i < row.size()); i++) {
+                const std::string_view cell = row[i];
+                const uint32_t len = cell.size();
+                out.write(reinterpret_cast<const char*>(&len), sizeof(len));
+                out.write(cell.data(), len);
+            }
+        }
+    }
+    out.close();
+    if (!out) {
+        throw Exp("Error writing snapshot " + tmpPath);
+    }
+    if (durable) {
+        sync(tmpPath);  // The data must be on disk before it is renamed
+    }
+    std::filesystem::rename(tmpPath, path);
+    if (durable) {
+        const std::filesystem::path dir =
+            std::filesystem::path(path).parent_path();
+        sync(dir.empty() ? "." : dir.string());
+    }
+}
+
+void TableSnapshot::sync(const std::string& path) {
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        throw Exp("Unable to open " + path + ": " + std::strerror(errno));
+    }
+    const int rc = fsync(fd);
+    const int error = errno;
+    close(fd);
+    if (rc == -1) {
+        throw Exp("Unable to flush " + path + ": " + std::strerror(error));
+    }
+}
+
+bool TableSnapshot::load(CSV& csv, const std::string& path,
+                         const std::string& stamp) {
+    std::ifstream in(path, std::ios::binary);
+    std::string magic, fileStamp, header;
+    size_t numRows = 0;
+    if (!std::getline(in, magic) || magic != SnapshotMagic ||
+        !std::getline(in, fileStamp) || fileStamp != stamp ||
+        !std::getline(in, header) || !(in >> numRows) || in.get() != '\n') {
+        return false;  // Missing or stale snapshot
+    }
+    // Use the standard loader to setup the column names
+    CSV data;
+    std::istringstream hdr(header + "\n");
+    data.load(hdr);
+    data.reserve(numRows);
+    StrVec cells;
+    for (size_t r = 0; (r < numRows); r++) {
+        uint32_t numCells;
+        if (!in.read(reinterpret_cast<char*>(&numCells), sizeof(numCells))) {
+            return false;  // Truncated snapshot
+        }
+        cells.resize(numCells);
+        for (auto& cell : cells) {
+            uint32_t len;
+            if (!in.read(reinterpret_cast<char*>(&len), sizeof(len))) {
+                return false;  // Truncated snapshot
+            }
+            cell.resize(len);
+            if (!in.read(cell.data(), len)) {
+                return false;
+            }
+        }
+        data.emplace_back(cells);
+    }
+    csv.move(data);
+    return true;
+}
+
+std::string TableSnapshot::readStamp(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::string magic, stamp;
+    if (!std::getline(in, magic) || magic != SnapshotMagic ||
+        !std::getline(in, stamp)) {
+        return "";
+    }
+    return stamp;
+}
+
+std::string TableSnapshot::sourceStamp(const std::string& fileOrURL) {
+    if (fileOrURL.find("http://") == 0) {
+        return "";
+    }
+    std::error_code ec;
+    const auto size = std::filesystem::file_size(fileOrURL, ec);
+    const auto time = std::filesystem::last_write_time(fileOrURL, ec);
+    if (ec) {
+        return "";
+    }
+    return std::to_string(size) + " " +
+           std::to_string(time.time_since_epoch().count());
+}
+
+long TableSnapshot::estimateMemory(const TableEntry::Segment& rows) {
+    long bytes = sizeof(rows) + rows.capacity() * sizeof(TableRow);
+    for (const auto& row : rows) {
+        bytes += row.capacity();
+    }
+    return bytes;
+}
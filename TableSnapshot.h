@@ -0,0 +1,126 @@
+#ifndef TABLE_SNAPSHOT_H
+#define TABLE_SNAPSHOT_H
+
+/*
+ * A simple binary format to save and restore the contents of a CSV. A
+ * binary snapshot is much faster to load than a CSV as the values do not
+ * have to be tokenized. Snapshots are used to quickly reload tables that
+ * were evicted from memory.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "CSV.h"
+#include "TableVersion.h"
+
+/**
+ * This class has static helper methods to write and read binary snapshots
+ * of a CSV. Similar to the Helper class, this class is never instantiated.
+ * The format of a snapshot is:
+ *
+ *     SQLAIR-SNAPSHOT 2\n
+ *     <stamp>\n
+ *     <column names as a CSV header line>\n
+ *     <number of rows>\n
+ *     <for each row: 4-byte number of cells followed by, for each cell,
+ *      its 4-byte length and its characters>
+ *
+ * The number of cells is stored for each row as rows may have fewer cells
+ * than there are columns (e.g., ragged lines in the source file).
+ */
+class TableSnapshot {
+public:
+    /**
+     * Writes a snapshot of a table to a given file. The file is first
+     * written to a temporary file and then renamed so that a partially
+     * written snapshot is never used.
+     *
+     * @param version The version of the table to be written.
+     *
+     * @param path The path to the snapshot file.
+     *
+     * @param stamp A string that identifies the version of the source of
+     * the CSV (see sourceStamp()).
+     *
+     * @param durable If true, the snapshot and its directory are flushed to
+     * disk (see sync()) before this method returns, e.g., for checkpoints
+     * that replace redo logs.
+     *
+     * @exception Exp This method throws an exception if the snapshot could
+     * not be written.
+     */
+    static void save(const TableVersion& version, const std::string& path,
+                     const std::string& stamp, const bool durable = false);
+
+    /**
+     * Loads a CSV from a snapshot, if the snapshot exists and was created
+     * from the same version of the source.
+     *
+     * @param csv The empty CSV into which the data is to be loaded.
+     *
+     * @param path The path to the snapshot file.
+     *
+     * @param stamp The current version of the source (see sourceStamp()).
+     *
+     * @return This method returns true if the CSV was loaded from the
+     * snapshot. It returns false if the snapshot does not exist, is stale,
+     * or is corrupt, in which case csv is unchanged.
+     */
+    static bool load(CSV& csv, const std::string& path,
+                     const std::string& stamp);
+
+    /**
+     * Read the stamp of a snapshot without loading its data.
+     *
+     * @param path The path to the snapshot file.
+     *
+     * @return The stamp with which the snapshot was saved or an empty
+     * string if the snapshot does not exist or is not valid.
+     */
+    static std::string readStamp(const std::string& path);
+
+    /**
+     * Obtain a string that identifies the current version of the source of
+     * a table. For local files, this is the file's size and modification
+     * time. For URLs this is an empty string as their version is checked
+     * with the web-server (see HttpClient::validator()).
+     *
+     * @param fileOrURL The path or URL from where the table is loaded.
+     *
+     * @return A string identifying the version of the source.
+     */
+    static std::string sourceStamp(const std::string& fileOrURL);
+
+    /**
+     * Estimate the number of bytes of memory used by the rows of a segment
+     * of a table.
+     *
+     * @param rows The rows whose memory usage is to be estimated.
+     *
+     * @return The estimated number of bytes used by the rows.
+     */
+    static long estimateMemory(const TableEntry::Segment& rows);
+
+    /**
+     * Flush a file, or the entries of a directory, to disk so that they
+     * survive a crash of the machine.
+     *
+     * @param path The path to the file or directory.
+     *
+     * @exception Exp This method throws an exception if the data could not
+     * be flushed.
+     */
+    static void sync(const std::string& path);
+
+private:
+    /**
+     * This class is never meant to be instantiated. Hence the constructor
+     * is intentionally private.
+     */
+    TableSnapshot();
+};
+
+#endif /* TABLE_SNAPSHOT_H */
@@ -0,0 +1,15 @@
+/*
+ * Implementation of the copy-on-write versions of a table.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include "TableVersion.h"
+
+TableVersion TableVersion::freeze(TableEntry& table) {
+    TableVersion version;
+    version.columns = table.csv.getColumnNames();
+    version.numRows = table.size();
+    version.segments = table.share();
+    return version;
+}
@@ -0,0 +1,82 @@
+#ifndef TABLE_VERSION_H
+#define TABLE_VERSION_H
+
+/*
+ * Immutable versions of a table for long-running reads, such as a select
+ * over a huge table or a save. A version is made of the reference-counted
+ * segments (blocks of consecutive rows) of the table itself. Creating a
+ * version copies no rows: the table copies a segment held by a version
+ * before it changes the segment (see TableEntry). Queries holding a
+ * version read it without any locks while updates proceed on the table.
+ * A version remains valid even if its table is reloaded, replaced, or
+ * evicted.
+ *
+ * Copyright 2023 yurj@miamioh.edu
+ */
+
+#include <memory>
+#include <vector>
+#include "TableEntry.h"
+
+/**
+ * A point-in-time, read-only copy of the rows of a table.
+ */
+class TableVersion {
+public:
+    /** The type of a segment, i.e., a block of consecutive rows */
+    using Segment = TableEntry::Segment;
+
+    /** A shared pointer to an immutable segment */
+    using SegmentPtr = TableEntry::SegmentPtr;
+
+    /** The number of rows in each segment (except perhaps the last one) */
+    static constexpr size_t SegmentRows = TableEntry::SegmentRows;
+
+    /**
+     * Obtain the current version of a table. No rows are copied. So the
+     * caller holds its lock only briefly.
+     *
+     * @note The caller must hold table.tableMutex in exclusive mode so that
+     * no rows are changed or appended while the version is created. A
+     * table that is not used by any other thread (e.g., while it is being
+     * evicted) does not need to be locked.
+     *
+     * @param table The table whose current version is to be returned.
+     *
+     * @return The current version of the table.
+     */
+    static TableVersion freeze(TableEntry& table);
+
+    /**
+     * Obtain the number of rows in this version.
+     *
+     * @return The number of rows.
+     */
+    size_t size() const { return numRows; }
+
+    /**
+     * Obtain the names of the columns of this version.
+     *
+     * @return The column names.
+     */
+    const StrVec& getColumnNames() const { return columns; }
+
+    /**
+     * Obtain the segments of this version, in order.
+     *
+     * @return The segments, each with SegmentRows rows except the last.
+     */
+    const std::vector<SegmentPtr>& getSegments() const { return segments; }
+
+private:
+    /** The names of the columns */
+    StrVec columns;
+
+    /** The segments with the rows */
+    std::vector<SegmentPtr> segments;
+
+    /** The total number of rows in the segments */
+    size_t numRows = 0;
+};
+
+#endif /* TABLE_VERSION_H */
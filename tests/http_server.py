@@ -0,0 +1,136 @@
+#!/usr/bin/env python3
+#
+# A stand-in web-server for testing the HTTP features of SQL-AIR (see
+# http_tests.txt and run_http_tests.sh). It serves the CSV files in a
+# directory with the behaviors that SQL-AIR handles:
+#
+#   GET /<file>          ETag, conditional requests ("304 Not Modified")
+#                        and byte ranges ("206 Partial Content").
+#   GET /chunked/<file>  The whole file (ranges are ignored), sent with
+#                        "Transfer-Encoding: chunked" and compressed with
+#                        gzip if the client accepts it.
+#   PUT /<file>          Stores the (chunked, possibly gzipped) body in
+#                        memory. Later GETs of the file, via either path,
+#                        return the stored body. Files on disk are never
+#                        changed.
+#
+# Usage: python3 tests/http_server.py <port> [<directory>]
+#
+# Copyright 2023 yurj@miamioh.edu
+
+import gzip
+import hashlib
+import http.server
+import os
+import re
+import sys
+import threading
+
+# Bodies received via PUT, indexed by file name
+uploads = {}
+uploadsLock = threading.Lock()
+
+
+class Handler(http.server.BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def end_headers(self):
+        # Each request uses its own connection, as SQL-AIR does
+        self.send_header("Connection", "close")
+        self.close_connection = True
+        super().end_headers()
+
+    def fileName(self):
+        """The name of the file requested, without the /chunked prefix"""
+        path = self.path.split("?")[0]
+        if path.startswith("/chunked/"):
+            path = path[len("/chunked"):]
+        return os.path.basename(path)
+
+    def readFile(self):
+        """The data of the requested file (or its upload) or None"""
+        name = self.fileName()
+        with uploadsLock:
+            if name in uploads:
+                return uploads[name]
+        path = os.path.join(root, name)
+        if not os.path.isfile(path):
+            return None
+        with open(path, "rb") as data:
+            return data.read()
+
+    def do_GET(self):
+        data = self.readFile()
+        if data is None:
+            self.send_error(404)
+            return
+        etag = '"%s"' % hashlib.sha1(data).hexdigest()
+        if self.headers.get("If-None-Match") == etag:
+            self.send_response(304)
+            self.send_header("ETag", etag)
+            self.send_header("Content-Length", "0")
+            self.end_headers()
+            return
+        if self.path.startswith("/chunked/"):
+            self.sendChunked(data, etag)
+            return
+        match = re.match(r"bytes=(\d+)-(\d*)$", self.headers.get("Range", ""))
+        if match and int(match.group(1)) < len(data):
+            start = int(match.group(1))
+            end = min(int(match.group(2) or len(data) - 1), len(data) - 1)
+            self.send_response(206)
+            self.send_header("Content-Range",
+                             "bytes %d-%d/%d" % (start, end, len(data)))
+            data = data[start:end + 1]
+        else:
+            self.send_response(200)
+        self.send_header("ETag", etag)
+        self.send_header("Accept-Ranges", "bytes")
+        self.send_header("Content-Length", str(len(data)))
+        self.end_headers()
+        self.wfile.write(data)
+
+    def sendChunked(self, data, etag):
+        """Send the whole file in chunks, compressed if accepted"""
+        self.send_response(200)
+        self.send_header("ETag", etag)
+        if "gzip" in self.headers.get("Accept-Encoding", ""):
+            data = gzip.compress(data)
+            self.send_header("Content-Encoding", "gzip")
+        self.send_header("Transfer-Encoding", "chunked")
+        self.end_headers()
+        for pos in range(0, len(data), 4096):
+            chunk = data[pos:pos + 4096]
+            self.wfile.write(b"%x\r\n" % len(chunk) + chunk + b"\r\n")
+        self.wfile.write(b"0\r\n\r\n")
+
+    def do_PUT(self):
+        if self.headers.get("Transfer-Encoding") == "chunked":
+            body = b""
+            while True:
+                size = int(self.rfile.readline().split(b";")[0], 16)
+                if size == 0:
+                    # Skip the trailers, if any
+                    while self.rfile.readline() not in (b"\r\n", b"\n", b""):
+                        pass
+                    break
+                body += self.rfile.read(size)
+                self.rfile.readline()
+        else:
+            body = self.rfile.read(int(self.headers.get("Content-Length", 0)))
+        if self.headers.get("Content-Encoding") == "gzip":
+            body = gzip.decompress(body)
+        with uploadsLock:
+            uploads[self.fileName()] = body
+        self.send_response(204)
+        self.send_header("Content-Length", "0")
+        self.end_headers()
+
+    def log_message(self, format, *args):
+        pass  # Keep the output of the tests clean
+
+
+if __name__ == "__main__":
+    root = sys.argv[2] if len(sys.argv) > 2 else "."
+    server = http.server.ThreadingHTTPServer(("", int(sys.argv[1])), Handler)
+    server.serve_forever()
@@ -0,0 +1,65 @@
+#!/bin/bash
+#
+# Run the tests of the options of the "use" statement and of streamed
+# queries (feature_tests.txt), and check the statements whose output
+# includes timings, which mt_tester cannot compare exactly: "explain
+# analyze", "use" with several tables, and "wait save". The data files
+# are copied to a temporary directory so that the files in the
+# repository are never changed.
+#
+# Usage (from the top-level directory):
+#     tests/run_feature_tests.sh [<sqlair executable> [<mt_tester executable>]]
+#
+# Copyright 2023 yurj@miamioh.edu
+
+sqlair=$(realpath "${1:-./sqlair}")
+tester=$(realpath "${2:-./mt_tester}")
+tests=$(realpath "$(dirname "$0")")
+top=$(dirname "$tests")
+work=$(mktemp -d)
+cp "$top"/test.csv "$top"/movies_db_20.csv "$top"/airports.csv "$work"
+cd "$work" || exit 1
+
+port=$((9500 + RANDOM % 400))
+"$sqlair" $port > sqlair.log 2>&1 &
+pid=$!
+trap 'kill $pid; rm -rf "$work"' EXIT
+sleep 0.5
+
+status=0
+# Check the output of a test (ok or FAIL followed by the output)
+check() {
+    if [ "$2" = 0 ]; then
+        echo "ok ($1)"
+    else
+        echo "FAIL ($1)"
+        echo "$3"
+        status=1
+    fi
+}
+
+out=$("$tester" "$tests/feature_tests.txt" $port 2>&1)
+echo "$out" | grep -q "Testing completed" &&
+    ! echo "$out" | grep -q "Invalid msg"
+check "feature_tests.txt" $? "$out"
+
+# Run one query and print the body of the response
+query() {
+    curl -s -G "http://localhost:$port/sql-air" --data-urlencode "query=$1"
+}
+
+out=$(query "explain analyze select title from test.csv where year = 2006;")
+echo "$out" | grep -q "^2 row(s) selected.$" &&
+    echo "$out" | grep -q "^Execution time: [0-9.e+-]* ms"
+check "explain analyze" $? "$out"
+
+out=$(query "use test.csv, movies_db_20.csv, airports.csv;")
+[ "$(echo "$out" | grep -c "^Loaded .*\.csv in [0-9.e+-]* ms$")" = 3 ]
+check "use several tables" $? "$out"
+
+query "update movies_db_20.csv set rating = 7 where movieid = 98491;" > /dev/null
+out=$(query "wait save movies_db_20.csv;")
+echo "$out" | grep -q "^movies_db_20.csv saved.$" &&
+    grep -q "Paperman.*\"7\"" movies_db_20.csv
+check "wait save" $? "$out"
+exit $status
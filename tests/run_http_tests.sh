@@ -0,0 +1,49 @@
+#!/bin/bash
+#
+# Run the tests of remote CSVs (http_tests.txt) against the stand-in
+# web-server (http_server.py). The data files are copied to a temporary
+# directory so that the files in the repository are never changed. The
+# tests are run twice, each time with a fresh SQL-AIR server sharing one
+# cache directory: the first pass downloads and caches the files and the
+# second pass revalidates the cached copies ("304 Not Modified").
+#
+# Usage (from the top-level directory):
+#     tests/run_http_tests.sh [<sqlair executable> [<mt_tester executable>]]
+#
+# Copyright 2023 yurj@miamioh.edu
+
+sqlair=$(realpath "${1:-./sqlair}")
+tester=$(realpath "${2:-./mt_tester}")
+tests=$(realpath "$(dirname "$0")")
+top=$(dirname "$tests")
+work=$(mktemp -d)
+cp "$top"/test.csv "$top"/movies_db_20.csv "$top"/airports.csv "$work"
+cd "$work" || exit 1
+
+python3 "$tests/http_server.py" 8090 "$work" &
+httpPid=$!
+trap 'kill $httpPid; rm -rf "$work"' EXIT
+sleep 0.5
+
+# Split the downloads into several ranges even for the small data files
+export SQLAIR_CACHE_DIR="$work/cache" SQLAIR_RANGE_KB=64
+port=$((9000 + RANDOM % 500))
+status=0
+for pass in download revalidate; do
+    "$sqlair" $port > sqlair.log 2>&1 &
+    pid=$!
+    sleep 0.5
+    out=$("$tester" "$tests/http_tests.txt" $port 2>&1)
+    if ! echo "$out" | grep -q "Testing completed" ||
+        echo "$out" | grep -q "Invalid msg"; then
+        echo "FAIL ($pass)"
+        echo "$out"
+        status=1
+    else
+        echo "ok ($pass)"
+    fi
+    kill $pid
+    wait $pid 2> /dev/null
+    port=$((port + 1))
+done
+exit $status
@@ -11,6 +11,10 @@ var cmdID = 1;
 // to estimate the time taken to get response from the server.
 var startTime = 0;
 
+// A random identifier sent with each query so that the server keeps a
+// separate session (e.g., the most recently used CSV) for this page.
+var sessionID = Math.random().toString(36).substring(2);
+
 /**
  * This method intercepts and handles the enter key by sending a request
  * to the SQLAir web-serer.
@@ -130,6 +134,7 @@ function run(cmd) {
         console.log("Running command: " + cmd);
         cmd = encodeURIComponent(cmd);
         xhttp.open("GET", "../sql-air?query=" + cmd, false);
+        xhttp.setRequestHeader("X-SQLAir-Session", sessionID);
         // Save the tarting time.
         startTime = new Date().getMilliseconds();
         xhttp.send();